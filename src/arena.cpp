@@ -0,0 +1,80 @@
+#include "arena.h"
+
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+Arena::~Arena() {
+  for (Block &b : blocks) munmap(b.base, b.size);
+}
+
+void Arena::reset() {
+  current = offset = 0;
+  used_bytes = 0;
+}
+
+size_t Arena::reserved() const {
+  size_t total = 0;
+  for (const Block &b : blocks) total += b.size;
+  return total;
+}
+
+void *Arena::allocBytes(size_t n, size_t align) {
+  while (current < blocks.size()) {
+    size_t start = (offset + align - 1) & ~(align - 1);
+    if (start + n <= blocks[current].size) {
+      offset = start + n;
+      used_bytes += n;
+      peak_bytes = max(peak_bytes, used_bytes);
+      return blocks[current].base + start;
+    }
+    current++;
+    offset = 0;
+  }
+
+  // Map a new block, over-mapped by a block and trimmed so it starts on a
+  // 2 MB boundary
+  size_t size = (max(n, BLOCK_SIZE) + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+  char *p = (char *)mmap(nullptr, size + BLOCK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    cerr << "Error: out of memory" << endl;
+    exit(1);
+  }
+  char *base = (char *)(((size_t)p + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1));
+  if (base > p) munmap(p, base - p);
+  munmap(base + size, p + BLOCK_SIZE - base);
+  // Best effort, without THP support this is just ignored
+  if (huge_pages) madvise(base, size, MADV_HUGEPAGE);
+  blocks.push_back({base, size});
+  current = blocks.size() - 1;
+  offset = 0;
+  return allocBytes(n, align);
+}
+
+// Every operator new goes through here so the solver can show that its
+// search loop doesn't allocate
+static thread_local long long allocations = 0;
+
+long long threadAllocations() { return allocations; }
+
+void *operator new(size_t n) {
+  allocations++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t n) { return operator new(n); }
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete[](void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void operator delete[](void *p, size_t) noexcept { free(p); }
@@ -0,0 +1,89 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator owning everything an instance needs for the length of a
+// search. Memory comes from the OS in blocks of at least BLOCK_SIZE, 2 MB
+// aligned so that with huge pages on each block can be backed by
+// transparent huge pages. Nothing is freed on its own, reset() makes all of
+// it available again while keeping the blocks.
+class Arena {
+ public:
+  static const size_t BLOCK_SIZE = 2 << 20;
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena();
+
+  template <class T>
+  T *alloc(size_t n) {
+    return (T *)allocBytes(n * sizeof(T), alignof(T));
+  }
+  void reset();
+  // Only affects blocks mapped after the call
+  void setHugePages(bool on) { huge_pages = on; }
+
+  size_t used() const { return used_bytes; }
+  size_t peak() const { return peak_bytes; }
+  size_t reserved() const;
+  bool hugePages() const { return huge_pages; }
+
+ private:
+  struct Block {
+    char *base;
+    size_t size;
+  };
+  std::vector<Block> blocks;
+  size_t current = 0, offset = 0;
+  size_t used_bytes = 0, peak_bytes = 0;
+  bool huge_pages = false;
+
+  void *allocBytes(size_t n, size_t align);
+};
+
+// A run of T in an arena, how clauses and implication lists are stored
+template <class T>
+struct Span {
+  T *ptr = nullptr;
+  unsigned len = 0;
+
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + len; }
+  T *data() const { return ptr; }
+  unsigned size() const { return len; }
+  bool empty() const { return len == 0; }
+  T &operator[](unsigned i) const { return ptr[i]; }
+};
+
+// Fixed capacity stack in an arena. Never reallocates, pushing past the
+// capacity given to init() is a bug.
+template <class T>
+class Stack {
+ public:
+  void init(Arena &arena, unsigned capacity) {
+    ptr = arena.alloc<T>(capacity);
+    len = 0;
+  }
+  void push_back(T x) { ptr[len++] = x; }
+  void pop_back() { len--; }
+  T &back() const { return ptr[len - 1]; }
+  T &operator[](unsigned i) const { return ptr[i]; }
+  unsigned size() const { return len; }
+  bool empty() const { return len == 0; }
+  void clear() { len = 0; }
+  void resize(unsigned n) { len = n; }
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + len; }
+
+ private:
+  T *ptr = nullptr;
+  unsigned len = 0;
+};
+
+// Heap allocations (operator new) made by the calling thread so far
+long long threadAllocations();
+
+#endif
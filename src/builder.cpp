@@ -10,8 +10,8 @@ const char *KERNAL_NAME = "generated_kernal.cpp";
 class Builder {
   public:
     int var_cnt = 0, clause_cnt = 0;
-    // -1 (unassigned), 0 (false), 1 (true)
-    vector<int> vars = {};
+    // -1 (unassigned), 0 (false), 1 (true), a byte each as in the solvers
+    vector<signed char> vars = {};
     vector<vector<int>> clauses = {};
 
     void read(string infile);
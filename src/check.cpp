@@ -0,0 +1,308 @@
+#include "check.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+unique_ptr<istream> openInput(string infile);
+bool inputFailed(istream &in, string &error);
+bool isCompressed(string infile);
+
+bool PackedModel::set(int lit) {
+  size_t i = 2 * (size_t)(lit < 0 ? -lit : lit) + (lit < 0);
+  if (isTrue(-lit)) return false;
+  if (i >= 64 * bits.size()) bits.resize(i / 64 + 1);
+  bits[i >> 6] |= 1ULL << (i & 63);
+  return true;
+}
+
+void PackedModel::assign(const signed char *vals, int var_cnt,
+                         const vector<int> &order) {
+  bits.assign((2 * (size_t)var_cnt + 2 + 63) / 64, 0);
+  for (int v = 1; v <= var_cnt; v++) {
+    int var = order.empty() ? v : order[v];
+    set(vals[v] ? var : -var);
+  }
+}
+
+bool readModel(string path, PackedModel &model, string &error) {
+  ifstream fin(path);
+  if (!fin.is_open()) {
+    error = "couldn't open file " + path;
+    return false;
+  }
+  bool found = false;
+  for (string line; getline(fin, line);) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos) continue;
+    if (line[start] == 'v')
+      start++;
+    else if (!isdigit(line[start]) && line[start] != '-')
+      continue;  // s, c and anything else a solver prints around it
+    istringstream in(line.substr(start));
+    for (int lit; in >> lit;) {
+      if (lit == 0) continue;
+      if (!model.set(lit)) {
+        error = "model has both " + to_string(lit) + " and " +
+                to_string(-lit);
+        return false;
+      }
+      found = true;
+    }
+  }
+  if (!found) error = "no model in " + path;
+  return found;
+}
+
+// 0 for a line to skip, 1 for the problem line, -1 (with error set) for
+// anything else
+static int headerLine(const string &line, int &var_cnt, long long &clause_cnt,
+                      string &error) {
+  size_t start = line.find_first_not_of(" \t\r");
+  if (start == string::npos || line[start] == 'c') return 0;
+  istringstream in(line.substr(start));
+  string p, cnf;
+  in >> p >> cnf >> var_cnt >> clause_cnt;
+  if (p != "p" || cnf != "cnf") {
+    error = "expected cnf input file";
+    return -1;
+  }
+  if (!in || var_cnt < 0 || clause_cnt < 0) {
+    error = "malformed problem line";
+    return -1;
+  }
+  return 1;
+}
+
+// Scan state over part of the clause section. Its clauses are cut into
+// segments at the 0s: segment 0 continues whatever clause was open where the
+// part starts, the last one is still open where it ends. A chunk can only
+// tell whether each segment is satisfied, the chunks are stitched together
+// by mergeScans().
+struct Scan {
+  const PackedModel *model;
+  int var_cnt;
+  // 0s seen, whether segment 0 is satisfied, the first of segments
+  // 1..zeros - 1 that isn't and whether the open one is
+  long long zeros = 0;
+  bool first_sat = false;
+  long long first_unsat = -1;
+  bool sat = false;
+  // Hit the % line SATLIB files end with
+  bool stopped = false;
+  string error;
+
+  // A number may be cut off where the input handed to feed() ends
+  long long num = 0;
+  bool neg = false, in_num = false, line_start = true, skip_line = false;
+
+  void feed(const char *p, const char *end);
+  void finish() {
+    if (in_num) feed(" ", " " + 1);
+  }
+};
+
+void Scan::feed(const char *p, const char *end) {
+  // Everything in locals, stores through p's char type would otherwise
+  // force them back to memory on every byte
+  long long x = num, zero_cnt = zeros;
+  bool negative = neg, digits = in_num, at_line_start = line_start,
+       clause_sat = sat;
+  auto literal = [&]() {
+    digits = false;
+    if (x == 0) {
+      if (zero_cnt == 0)
+        first_sat = clause_sat;
+      else if (!clause_sat && first_unsat < 0)
+        first_unsat = zero_cnt;
+      zero_cnt++;
+      clause_sat = false;
+    } else if (x > var_cnt) {
+      if (error.empty())
+        error = "literal " + string(negative ? "-" : "") + to_string(x) +
+                " out of range";
+    } else
+      clause_sat |= model->isTrue(negative ? -x : x);
+    x = 0;
+    negative = false;
+  };
+
+  while (p < end && error.empty()) {
+    if (skip_line) {
+      p = (const char *)memchr(p, '\n', end - p);
+      if (!p) break;
+      skip_line = false;
+    }
+    char c = *p++;
+    if ((unsigned char)(c - '0') < 10) {
+      // Anything longer than 12 digits is out of range anyway
+      if (x < (1LL << 40)) x = x * 10 + (c - '0');
+      digits = true;
+      at_line_start = false;
+      continue;
+    }
+    if (digits) literal();
+    if (c == '\n')
+      at_line_start = true;
+    else if (c == ' ' || c == '\t' || c == '\r')
+      ;
+    else if (c == '-') {
+      negative = true;
+      at_line_start = false;
+    } else if (at_line_start && c == 'c')
+      skip_line = true;
+    else if (at_line_start && c == '%') {
+      stopped = true;
+      break;
+    } else
+      error = string("unexpected character '") + c + "'";
+  }
+  num = x;
+  zeros = zero_cnt;
+  neg = negative;
+  in_num = digits;
+  line_start = at_line_start;
+  sat = clause_sat;
+}
+
+// Stitches the chunks' segments back into clauses 0..clause_cnt - 1 in
+// order, anything past them is ignored as the parser does
+static bool mergeScans(const vector<Scan> &scans, long long clause_cnt,
+                       string &error) {
+  long long clause = 0, falsified = -1;
+  bool open_sat = false;
+  for (const Scan &s : scans) {
+    if (clause >= clause_cnt) break;
+    if (!s.error.empty()) {
+      error = s.error;
+      return false;
+    }
+    if (s.zeros == 0)
+      open_sat |= s.sat;
+    else {
+      if (!(open_sat || s.first_sat) && falsified < 0) falsified = clause;
+      if (s.first_unsat >= 0 && falsified < 0)
+        falsified = clause + s.first_unsat;
+      clause += s.zeros;
+      open_sat = s.sat;
+    }
+    if (s.stopped) break;
+  }
+  if (falsified >= 0 && falsified < clause_cnt) {
+    error = "clause " + to_string(falsified + 1) + " is falsified";
+    return false;
+  }
+  if (clause < clause_cnt) {
+    error = "expected " + to_string(clause_cnt) +
+            " clauses, input ends after " + to_string(clause);
+    return false;
+  }
+  return true;
+}
+
+bool checkModel(const char *data, size_t n, const PackedModel &model,
+                int threads, string &error) {
+  int var_cnt = 0;
+  long long clause_cnt = 0;
+  size_t body = 0;
+  for (int found = 0; !found;) {
+    if (body >= n) {
+      error = "expected cnf input file, given empty input";
+      return false;
+    }
+    const char *nl = (const char *)memchr(data + body, '\n', n - body);
+    size_t end = nl ? nl - data : n;
+    found = headerLine(string(data + body, end - body), var_cnt, clause_cnt,
+                       error);
+    if (found < 0) return false;
+    body = end + 1;
+  }
+  body = min(body, n);
+
+  size_t size = n - body;
+  int chunk_cnt =
+      max<size_t>(1, min<size_t>(max(threads, 1), size / CHECK_MIN_CHUNK));
+  // Chunks start right after a newline, so no number is split
+  vector<size_t> begin(chunk_cnt + 1, n);
+  begin[0] = body;
+  for (int k = 1; k < chunk_cnt; k++) {
+    size_t at = max(begin[k - 1], body + size * k / chunk_cnt);
+    const char *nl = (const char *)memchr(data + at, '\n', n - at);
+    begin[k] = nl ? nl - data + 1 : n;
+  }
+  vector<Scan> scans(chunk_cnt);
+  auto run = [&](int k) {
+    scans[k].model = &model;
+    scans[k].var_cnt = var_cnt;
+    scans[k].feed(data + begin[k], data + begin[k + 1]);
+    scans[k].finish();
+  };
+  vector<thread> pool;
+  for (int k = 1; k < chunk_cnt; k++) pool.emplace_back(run, k);
+  run(0);
+  for (auto &t : pool) t.join();
+  return mergeScans(scans, clause_cnt, error);
+}
+
+bool checkModelFile(string path, const PackedModel &model, int threads,
+                    string &error) {
+  if (isCompressed(path)) {
+    unique_ptr<istream> in = openInput(path);
+    if (!in) {
+      error = "couldn't open file " + path;
+      return false;
+    }
+    int var_cnt = 0;
+    long long clause_cnt = 0;
+    int found = 0;
+    for (string line; !found && getline(*in, line);)
+      found = headerLine(line, var_cnt, clause_cnt, error);
+    if (found < 0) return false;
+    if (!found) {
+      if (inputFailed(*in, error)) return false;
+      error = "expected cnf input file, given empty input";
+      return false;
+    }
+    vector<Scan> scans(1);
+    scans[0].model = &model;
+    scans[0].var_cnt = var_cnt;
+    vector<char> buf(1 << 16);
+    while (in->read(buf.data(), buf.size()) || in->gcount() > 0)
+      scans[0].feed(buf.data(), buf.data() + in->gcount());
+    if (inputFailed(*in, error)) return false;
+    scans[0].finish();
+    return mergeScans(scans, clause_cnt, error);
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    error = "couldn't open file " + path;
+    return false;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return checkModel("", 0, model, threads, error);
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    error = "couldn't map file " + path;
+    return false;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  bool ok = checkModel((const char *)map, st.st_size, model, threads, error);
+  munmap(map, st.st_size);
+  return ok;
+}
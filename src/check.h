@@ -0,0 +1,50 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Formulas are only split across threads in chunks of at least this many
+// bytes, below that starting a thread costs more than it saves
+#define CHECK_MIN_CHUNK (1 << 20)
+
+// A model packed as the truth of every literal, bit 2 * var + (lit < 0), so
+// that checking a literal is a single lookup. Both literals of a variable
+// the model doesn't mention are false.
+class PackedModel {
+ public:
+  // False if lit contradicts a literal set before
+  bool set(int lit);
+  bool isTrue(int lit) const {
+    size_t i = 2 * (size_t)(lit < 0 ? -lit : lit) + (lit < 0);
+    return i < 64 * bits.size() && (bits[i >> 6] >> (i & 63) & 1);
+  }
+  // vals[1..var_cnt] in the solver's numbering, order[v] being the input
+  // number of variable v (or empty if they weren't renumbered). A free
+  // variable is taken as true, which is how the solvers print it.
+  void assign(const signed char *vals, int var_cnt,
+              const std::vector<int> &order);
+
+ private:
+  std::vector<uint64_t> bits;
+};
+
+// Reads the v lines of solver output (or bare literals, 0s ignored) from
+// path. False with error set if it can't be read, has no model or
+// contradicts itself.
+bool readModel(std::string path, PackedModel &model, std::string &error);
+
+// Evaluates the DIMACS formula in data[0..n) against model in one pass
+// without building any clauses. Past the header it is split at line
+// boundaries into chunks checked by up to threads threads. False with error
+// naming the first falsified clause (counted from 1), or why data isn't a
+// formula.
+bool checkModel(const char *data, size_t n, const PackedModel &model,
+                int threads, std::string &error);
+// Same for a file. Plain ones are mapped and checked in chunks, compressed
+// ones are streamed through the decompressor on one thread.
+bool checkModelFile(std::string path, const PackedModel &model, int threads,
+                    std::string &error);
+
+#endif
@@ -0,0 +1,381 @@
+#include "cnf.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+unique_ptr<istream> openInput(string infile);
+bool inputFailed(istream &in, string &error);
+
+static const char MAGIC[8] = {'F', 'S', 'A', 'T', 'C', 'N', 'F', '2'};
+// Header is padded to a page so the literal array is page aligned in the
+// mapping and can be handed to the OpenCL runtime as a host pointer.
+static const size_t HEADER_SIZE = 4096;
+
+struct CacheHeader {
+  char magic[8];
+  int64_t var_cnt, clause_cnt, lit_cnt;
+  // Source file identity, checked on every load
+  int64_t src_size, src_mtime_ns, src_ino, src_dev;
+  // Over the source text and over the literal and offset arrays, only
+  // checked when revalidating
+  uint64_t src_hash, payload_sum;
+  // Over the header itself
+  uint64_t header_sum;
+};
+
+uint64_t hashBytes(const void *data, size_t n, uint64_t h) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+  for (; n > 0; p++, n--) h = (h ^ *p) * 0x100000001b3ULL;
+  return h;
+}
+
+// Size, mtime, inode and device of infile, a stat and nothing more
+static bool sourceIdentity(string infile, CacheHeader &h) {
+  struct stat st;
+  if (stat(infile.c_str(), &st) < 0) return false;
+  h.src_size = st.st_size;
+  h.src_mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  h.src_ino = st.st_ino;
+  h.src_dev = st.st_dev;
+  return true;
+}
+
+// Content hash of infile, a full pass over it
+static bool sourceHash(string infile, uint64_t &hash) {
+  int fd = open(infile.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  hash = 0;
+  if (st.st_size > 0) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    hash = hashBytes(p, st.st_size);
+    munmap(p, st.st_size);
+  }
+  close(fd);
+  return true;
+}
+
+static uint64_t headerSum(const CacheHeader &h) {
+  return hashBytes(&h, offsetof(CacheHeader, header_sum));
+}
+
+static bool parseClauses(istream &fin, CNF &cnf, string &error) {
+  char c;  // check if line is comment
+  string s;
+  while (true) {
+    if (!(fin >> c)) {
+      error = "expected cnf input file, given empty input";
+      return false;
+    }
+    if (c == 'c')
+      getline(fin, s);
+    else
+      break;
+  }
+  fin >> s;
+  if (s != "cnf") {
+    error = "expected cnf input file, given " + s;
+    return false;
+  }
+  fin >> cnf.var_cnt >> cnf.clause_cnt;
+  if (!fin || cnf.var_cnt < 0 || cnf.clause_cnt < 0) {
+    error = "malformed problem line";
+    return false;
+  }
+  cnf.lit_buf.clear();
+  cnf.offset_buf.assign(1, 0);
+  int var;
+  for (int i = 0; i < cnf.clause_cnt; i++) {
+    for (fin >> var; fin && var != 0; fin >> var) {
+      if (var < -cnf.var_cnt || var > cnf.var_cnt) {
+        error = "literal " + to_string(var) + " out of range";
+        return false;
+      }
+      cnf.lit_buf.push_back(var);
+    }
+    if (!fin) {
+      error = "expected " + to_string(cnf.clause_cnt) +
+              " clauses, input ends after " + to_string(i);
+      return false;
+    }
+    cnf.offset_buf.push_back(cnf.lit_buf.size());
+  }
+  cnf.lits = cnf.lit_buf.data();
+  cnf.offsets = cnf.offset_buf.data();
+  return true;
+}
+
+bool parseDIMACS(istream &fin, CNF &cnf, string &error) {
+  bool ok = parseClauses(fin, cnf, error);
+  // Corrupt compressed input reads as a short file, which is the less
+  // useful of the two errors
+  return !inputFailed(fin, error) && ok;
+}
+
+void readDIMACS(string infile, CNF &cnf) {
+  unique_ptr<istream> in = openInput(infile);
+  if (!in) {
+    cerr << "Error: couldn't open file " << infile << endl;
+    exit(0);
+  }
+  string error;
+  if (!parseDIMACS(*in, cnf, error)) {
+    cerr << "Error: " << error << endl;
+    exit(1);
+  }
+}
+
+void readCached(string infile, CNF &cnf, bool revalidate) {
+  string cache_file = cachePath(infile);
+  if (loadCache(cache_file, infile, cnf, revalidate)) return;
+  readDIMACS(infile, cnf);
+  writeCache(cache_file, infile, cnf);
+}
+
+bool tryReadDIMACS(string infile, CNF &cnf, string &error) {
+  unique_ptr<istream> in = openInput(infile);
+  if (!in) {
+    error = "couldn't open file " + infile;
+    return false;
+  }
+  return parseDIMACS(*in, cnf, error);
+}
+
+bool tryReadCached(string infile, CNF &cnf, string &error, bool revalidate) {
+  string cache_file = cachePath(infile);
+  if (loadCache(cache_file, infile, cnf, revalidate)) return true;
+  if (!tryReadDIMACS(infile, cnf, error)) return false;
+  writeCache(cache_file, infile, cnf);
+  return true;
+}
+
+bool kernelClauses(const CNF &cnf, vector<int> &clauses, string &error) {
+  clauses.resize(3 * (size_t)cnf.clause_cnt);
+  for (int c = 0; c < cnf.clause_cnt; c++) {
+    unsigned begin = cnf.offsets[c], len = cnf.offsets[c + 1] - begin;
+    if (len == 0 || len > 3) {
+      error = "the kernels need clauses of 1 to 3 literals, clause " +
+              to_string(c + 1) + " has " + to_string(len);
+      return false;
+    }
+    for (unsigned j = 0; j < 3; j++)
+      clauses[3 * c + j] = cnf.lits[begin + min(j, len - 1)];
+  }
+  return true;
+}
+
+void reorderCNF(CNF &cnf, vector<int> &order) {
+  int var_cnt = cnf.var_cnt, clause_cnt = cnf.clause_cnt;
+  // Clauses of variable v are occs[occ_begin[v]..occ_begin[v + 1])
+  vector<unsigned> occ_begin(var_cnt + 2, 0), occs(cnf.litCnt());
+  for (unsigned i = 0; i < cnf.litCnt(); i++)
+    occ_begin[abs(cnf.lits[i]) + 1]++;
+  for (int v = 1; v <= var_cnt + 1; v++) occ_begin[v] += occ_begin[v - 1];
+  vector<unsigned> fill(occ_begin.begin(), occ_begin.end() - 1);
+  for (int c = 0; c < clause_cnt; c++)
+    for (unsigned i = cnf.offsets[c]; i < cnf.offsets[c + 1]; i++)
+      occs[fill[abs(cnf.lits[i])]++] = c;
+  auto byDegree = [&](int a, int b) {
+    return occ_begin[a + 1] - occ_begin[a] < occ_begin[b + 1] - occ_begin[b];
+  };
+
+  // Cuthill-McKee: breadth first from the lowest degree variable not yet
+  // reached, each variable's new neighbours queued by increasing degree.
+  // Neighbours are found through clauses, each clause is expanded once.
+  vector<int> starts(var_cnt);
+  for (int v = 1; v <= var_cnt; v++) starts[v - 1] = v;
+  stable_sort(starts.begin(), starts.end(), byDegree);
+  vector<bool> var_seen(var_cnt + 1, false), clause_seen(clause_cnt, false);
+  vector<int> queue;
+  queue.reserve(var_cnt);
+  for (int start : starts) {
+    if (var_seen[start]) continue;
+    var_seen[start] = true;
+    queue.push_back(start);
+    for (size_t head = queue.size() - 1; head < queue.size(); head++) {
+      int v = queue[head];
+      size_t first = queue.size();
+      for (unsigned o = occ_begin[v]; o < occ_begin[v + 1]; o++) {
+        int c = occs[o];
+        if (clause_seen[c]) continue;
+        clause_seen[c] = true;
+        for (unsigned i = cnf.offsets[c]; i < cnf.offsets[c + 1]; i++) {
+          int u = abs(cnf.lits[i]);
+          if (var_seen[u]) continue;
+          var_seen[u] = true;
+          queue.push_back(u);
+        }
+      }
+      stable_sort(queue.begin() + first, queue.end(), byDegree);
+    }
+  }
+  // Reversed
+  order.assign(1, 0);
+  order.insert(order.end(), queue.rbegin(), queue.rend());
+  vector<int> renamed(var_cnt + 1, 0);
+  for (int v = 1; v <= var_cnt; v++) renamed[order[v]] = v;
+
+  vector<int> lowest(clause_cnt, var_cnt + 1), clause_order(clause_cnt);
+  for (int c = 0; c < clause_cnt; c++) {
+    clause_order[c] = c;
+    for (unsigned i = cnf.offsets[c]; i < cnf.offsets[c + 1]; i++)
+      lowest[c] = min(lowest[c], renamed[abs(cnf.lits[i])]);
+  }
+  stable_sort(clause_order.begin(), clause_order.end(),
+              [&](int a, int b) { return lowest[a] < lowest[b]; });
+  vector<int> lits;
+  vector<unsigned> offsets(1, 0);
+  lits.reserve(cnf.litCnt());
+  offsets.reserve(clause_cnt + 1);
+  for (int c : clause_order) {
+    for (unsigned i = cnf.offsets[c]; i < cnf.offsets[c + 1]; i++) {
+      int lit = cnf.lits[i];
+      lits.push_back(lit < 0 ? -renamed[-lit] : renamed[lit]);
+    }
+    offsets.push_back(lits.size());
+  }
+
+  cnf.lit_buf.swap(lits);
+  cnf.offset_buf.swap(offsets);
+  cnf.lits = cnf.lit_buf.data();
+  cnf.offsets = cnf.offset_buf.data();
+  if (cnf.map) {
+    munmap(cnf.map, cnf.map_size);
+    cnf.map = nullptr;
+    cnf.map_size = 0;
+  }
+}
+
+CNF::~CNF() {
+  if (map) munmap(map, map_size);
+}
+
+string cachePath(string infile) { return infile + ".fcnf"; }
+
+// Whether the mapped payload can be used as is: offsets rise from 0 to
+// lit_cnt and every literal names a variable. The checksum catches damage,
+// this keeps a cache that matches its checksum anyway from being read out
+// of bounds.
+static bool payloadValid(const CacheHeader &h, const int *lits,
+                         const unsigned *offsets) {
+  if (offsets[0] != 0 || offsets[h.clause_cnt] != h.lit_cnt) return false;
+  bool ok = true;
+  for (int64_t c = 0; c < h.clause_cnt; c++)
+    ok &= offsets[c] <= offsets[c + 1];
+  int var_cnt = h.var_cnt;
+  for (int64_t i = 0; i < h.lit_cnt; i++)
+    ok &= lits[i] != 0 && lits[i] >= -var_cnt && lits[i] <= var_cnt;
+  return ok;
+}
+
+bool loadCache(string cache_file, string infile, CNF &cnf, bool revalidate) {
+  int fd = open(cache_file.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < HEADER_SIZE) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const CacheHeader &h = *(const CacheHeader *)map;
+  CacheHeader src;
+  size_t lit_bytes = h.lit_cnt * sizeof(int);
+  size_t offset_bytes = (h.clause_cnt + 1) * sizeof(unsigned);
+  bool ok = !memcmp(h.magic, MAGIC, sizeof(MAGIC)) &&
+            h.header_sum == headerSum(h) && h.var_cnt >= 0 &&
+            h.var_cnt <= INT_MAX && h.lit_cnt >= 0 && h.lit_cnt <= UINT_MAX &&
+            h.clause_cnt >= 0 && h.clause_cnt < INT_MAX &&
+            (size_t)st.st_size == HEADER_SIZE + lit_bytes + offset_bytes &&
+            sourceIdentity(infile, src) && src.src_size == h.src_size &&
+            src.src_mtime_ns == h.src_mtime_ns && src.src_ino == h.src_ino &&
+            src.src_dev == h.src_dev;
+  const char *payload = (const char *)map + HEADER_SIZE;
+  // A few percent of a parse, unlike hashing the source, which is as much
+  // of a pass over it as parsing is
+  if (ok)
+    ok = hashBytes(payload + lit_bytes, offset_bytes,
+                   hashBytes(payload, lit_bytes)) == h.payload_sum &&
+         payloadValid(h, (const int *)payload,
+                      (const unsigned *)(payload + lit_bytes));
+  if (ok && revalidate)
+    ok = sourceHash(infile, src.src_hash) && src.src_hash == h.src_hash;
+  if (!ok) {
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  cnf.var_cnt = h.var_cnt;
+  cnf.clause_cnt = h.clause_cnt;
+  cnf.lits = (const int *)payload;
+  cnf.offsets = (const unsigned *)(payload + lit_bytes);
+  cnf.map = map;
+  cnf.map_size = st.st_size;
+  return true;
+}
+
+void writeCache(string cache_file, string infile, const CNF &cnf) {
+  CacheHeader h = {};
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.var_cnt = cnf.var_cnt;
+  h.clause_cnt = cnf.clause_cnt;
+  h.lit_cnt = cnf.litCnt();
+  if (!sourceIdentity(infile, h) || !sourceHash(infile, h.src_hash)) {
+    cerr << "Warning: couldn't stat " << infile << ", not caching" << endl;
+    return;
+  }
+  size_t lit_bytes = h.lit_cnt * sizeof(int);
+  size_t offset_bytes = (h.clause_cnt + 1) * sizeof(unsigned);
+  h.payload_sum = hashBytes(cnf.lits, lit_bytes);
+  h.payload_sum = hashBytes(cnf.offsets, offset_bytes, h.payload_sum);
+  h.header_sum = headerSum(h);
+
+  // Written under a temporary name and renamed so a concurrent run never
+  // maps a half written cache
+  string tmp = cache_file + ".tmp" + to_string(getpid());
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (!f) {
+    cerr << "Warning: couldn't write cache " << cache_file << endl;
+    return;
+  }
+  char header[HEADER_SIZE] = {};
+  memcpy(header, &h, sizeof(h));
+  bool ok = fwrite(header, 1, HEADER_SIZE, f) == HEADER_SIZE &&
+            fwrite(cnf.lits, 1, lit_bytes, f) == lit_bytes &&
+            fwrite(cnf.offsets, 1, offset_bytes, f) == offset_bytes;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), cache_file.c_str()) != 0) {
+    cerr << "Warning: couldn't write cache " << cache_file << endl;
+    unlink(tmp.c_str());
+  }
+}
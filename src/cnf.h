@@ -0,0 +1,73 @@
+#ifndef CNF_H
+#define CNF_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Preparsed CNF, either built by the DIMACS parser or mapped straight from
+// a cache file. Clause i is lits[offsets[i]..offsets[i + 1]), with no 0
+// terminators, so for 3-SAT lits is exactly the kernel's clause buffer.
+struct CNF {
+  int var_cnt = 0, clause_cnt = 0;
+  const int *lits = nullptr;
+  const unsigned *offsets = nullptr;
+
+  // Backing storage for whichever of the two it came from
+  std::vector<int> lit_buf = {};
+  std::vector<unsigned> offset_buf = {};
+  void *map = nullptr;
+  size_t map_size = 0;
+
+  CNF() = default;
+  CNF(const CNF &) = delete;
+  CNF &operator=(const CNF &) = delete;
+  ~CNF();
+  unsigned litCnt() const { return offsets[clause_cnt]; }
+};
+
+// Parses DIMACS text from fin, false (with error set) on malformed input
+bool parseDIMACS(std::istream &fin, CNF &cnf, std::string &error);
+// Parses a (possibly compressed) DIMACS file, exits on malformed input
+void readDIMACS(std::string infile, CNF &cnf);
+// As readDIMACS, but goes through the binary cache file next to infile,
+// (re)writing it if it is missing or stale. See loadCache() for revalidate.
+void readCached(std::string infile, CNF &cnf, bool revalidate = false);
+// As readDIMACS and readCached, but false (with error set) instead of
+// exiting, so one bad file in a batch doesn't end the rest
+bool tryReadDIMACS(std::string infile, CNF &cnf, std::string &error);
+bool tryReadCached(std::string infile, CNF &cnf, std::string &error,
+                   bool revalidate = false);
+
+// Renumbers the variables in reverse Cuthill-McKee order of the variable
+// interaction graph and sorts the clauses by their lowest variable, so
+// variables sharing clauses end up close together in memory. order[v] is
+// the original number of variable v (order[0] = 0). A mapped cache is
+// copied out and unmapped.
+void reorderCNF(CNF &cnf, std::vector<int> &order);
+
+// The kernels' clause buffer, exactly 3 literals per clause. Shorter clauses
+// are padded by repeating their last literal, which keeps their meaning, but
+// a kernel only propagates a clause with a single unassigned slot, so the
+// repeated literal itself is never implied, only checked for conflicts.
+// False (with error set) on an empty clause or one longer than 3.
+bool kernelClauses(const CNF &cnf, std::vector<int> &clauses,
+                   std::string &error);
+
+// Fast non-cryptographic hash, h chains calls over several buffers
+uint64_t hashBytes(const void *data, size_t n, uint64_t h = 0);
+
+// Cache file used for infile by --cache
+std::string cachePath(std::string infile);
+// Maps cache_file into cnf if it exists, its payload is intact (checksum
+// and bounds) and it still matches infile's size, mtime, inode and device,
+// which takes a stat and no pass over infile. revalidate also checks the
+// content hash of infile, for sources that may change without their mtime
+// moving. Returns false if it has to be rebuilt.
+bool loadCache(std::string cache_file, std::string infile, CNF &cnf,
+               bool revalidate = false);
+// Best effort, a cache that can't be written is only reported
+void writeCache(std::string cache_file, std::string infile, const CNF &cnf);
+
+#endif
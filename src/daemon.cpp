@@ -0,0 +1,103 @@
+#include "daemon.h"
+
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Jobs bigger than this are rejected rather than allocated
+static const uint32_t MAX_FRAME = 1u << 31;
+
+static bool writeAll(int fd, const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t written = write(fd, data, n);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    data += written;
+    n -= written;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t n) {
+  while (n > 0) {
+    ssize_t got = read(fd, data, n);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+    data += got;
+    n -= got;
+  }
+  return true;
+}
+
+bool sendFrame(int fd, const string &data) {
+  uint32_t len = htonl(data.size());
+  return writeAll(fd, (const char *)&len, sizeof(len)) &&
+         writeAll(fd, data.data(), data.size());
+}
+
+bool recvFrame(int fd, string &data) {
+  uint32_t len;
+  if (!readAll(fd, (char *)&len, sizeof(len))) return false;
+  len = ntohl(len);
+  if (len >= MAX_FRAME) return false;
+  data.resize(len);
+  return readAll(fd, &data[0], len);
+}
+
+static sockaddr_un socketAddress(string socket_path) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    cerr << "Error: socket path too long " << socket_path << endl;
+    exit(1);
+  }
+  strcpy(addr.sun_path, socket_path.c_str());
+  return addr;
+}
+
+void serve(string socket_path, function<string(const string &)> solve) {
+  // A client going away mid response must not take the daemon with it
+  signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr = socketAddress(socket_path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path.c_str());
+  if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, 16) < 0) {
+    cerr << "Error: couldn't listen on " << socket_path << ": "
+         << strerror(errno) << endl;
+    exit(1);
+  }
+  cerr << "c listening on " << socket_path << endl;
+  string job;
+  while (true) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      cerr << "Error: accept failed: " << strerror(errno) << endl;
+      exit(1);
+    }
+    while (recvFrame(fd, job))
+      if (!sendFrame(fd, solve(job))) break;
+    close(fd);
+  }
+}
+
+int connectDaemon(string socket_path) {
+  sockaddr_un addr = socketAddress(socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
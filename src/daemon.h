@@ -0,0 +1,24 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <functional>
+#include <string>
+
+// Framing used on the fsatd socket, both ways: a 4 byte big endian length
+// followed by that many bytes. A request is the DIMACS text of one job, the
+// response is the solver output for it ("s ..."/"v ..." and "c ..." lines).
+// Any number of jobs can be sent over one connection.
+bool sendFrame(int fd, const std::string &data);
+bool recvFrame(int fd, std::string &data);
+
+// Listens on a Unix socket at socket_path and answers every job with
+// solve(job), one job at a time, until the process is killed. The backend
+// is expected to be set up before this is called and to keep its state
+// across jobs.
+void serve(std::string socket_path,
+           std::function<std::string(const std::string &)> solve);
+
+// Connects to a running daemon, -1 on failure
+int connectDaemon(std::string socket_path);
+
+#endif
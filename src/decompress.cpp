@@ -0,0 +1,281 @@
+#include <bzlib.h>
+#include <lzma.h>
+#include <zlib.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+enum Format {
+  Plain,
+  Gzip,
+  Xz,
+  Bzip2,
+};
+
+static Format detectFormat(FILE *f) {
+  unsigned char magic[6] = {};
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  rewind(f);
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return Gzip;
+  if (n >= 6 && !memcmp(magic, "\xfd" "7zXZ\0", 6)) return Xz;
+  if (n >= 3 && !memcmp(magic, "BZh", 3)) return Bzip2;
+  return Plain;
+}
+
+// Decompresses a file on its own thread into fixed size chunks and hands
+// them to the parser through a small bounded queue, so decoding the next
+// chunk overlaps with parsing the current one.
+class DecompressBuf : public streambuf {
+ public:
+  static const size_t CHUNK_SIZE = 1 << 20;
+  static const size_t MAX_CHUNKS = 4;
+
+  DecompressBuf(FILE *f, Format format);
+  ~DecompressBuf();
+  // Whether decoding stopped on corrupt or truncated input, with error set.
+  // Only final once underflow() has returned eof.
+  bool failed(string &error);
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  FILE *f;
+  Format format;
+  thread producer;
+
+  mutex m;
+  condition_variable cv;
+  deque<vector<char>> chunks;
+  vector<char> current;
+  bool finished = false, stop = false;
+  string error;
+
+  void run();
+  bool decodeGzip();
+  bool decodeXz();
+  bool decodeBzip2();
+  // Queue out[0..n) as a chunk, returns false if the reader went away
+  bool emit(vector<char> &out, size_t n);
+};
+
+DecompressBuf::DecompressBuf(FILE *f, Format format) : f(f), format(format) {
+  setg(nullptr, nullptr, nullptr);
+  producer = thread(&DecompressBuf::run, this);
+}
+
+DecompressBuf::~DecompressBuf() {
+  {
+    lock_guard<mutex> lock(m);
+    stop = true;
+  }
+  cv.notify_all();
+  producer.join();
+  fclose(f);
+}
+
+streambuf::int_type DecompressBuf::underflow() {
+  unique_lock<mutex> lock(m);
+  cv.wait(lock, [this] { return !chunks.empty() || finished; });
+  // A decoder error ends the input like a short file, failed() tells them
+  // apart
+  if (chunks.empty()) return traits_type::eof();
+  current = move(chunks.front());
+  chunks.pop_front();
+  lock.unlock();
+  cv.notify_all();
+  setg(current.data(), current.data(), current.data() + current.size());
+  return traits_type::to_int_type(current[0]);
+}
+
+bool DecompressBuf::failed(string &error) {
+  lock_guard<mutex> lock(m);
+  if (this->error.empty()) return false;
+  error = this->error;
+  return true;
+}
+
+bool DecompressBuf::emit(vector<char> &out, size_t n) {
+  unique_lock<mutex> lock(m);
+  cv.wait(lock, [this] { return chunks.size() < MAX_CHUNKS || stop; });
+  if (stop) return false;
+  out.resize(n);
+  chunks.push_back(move(out));
+  lock.unlock();
+  cv.notify_all();
+  out.resize(CHUNK_SIZE);
+  return true;
+}
+
+void DecompressBuf::run() {
+  bool ok = true;
+  if (format == Gzip)
+    ok = decodeGzip();
+  else if (format == Xz)
+    ok = decodeXz();
+  else
+    ok = decodeBzip2();
+  lock_guard<mutex> lock(m);
+  if (!ok && error.empty() && !stop) error = "corrupt compressed input";
+  finished = true;
+  cv.notify_all();
+}
+
+bool DecompressBuf::decodeGzip() {
+  vector<char> in(CHUNK_SIZE), out(CHUNK_SIZE);
+  z_stream z = {};
+  // 32 => detect gzip/zlib header
+  if (inflateInit2(&z, 15 + 32) != Z_OK) return false;
+  int ret = Z_OK;
+  bool ok = true, in_member = false;
+  while (ok) {
+    z.next_in = (Bytef *)in.data();
+    z.avail_in = fread(in.data(), 1, in.size(), f);
+    if (z.avail_in == 0) {
+      ok = !in_member;  // truncated input
+      break;
+    }
+    in_member = true;
+    // Keep going while there is input or inflate may still hold output
+    do {
+      z.next_out = (Bytef *)out.data();
+      z.avail_out = out.size();
+      ret = inflate(&z, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        ok = false;
+        break;
+      }
+      size_t n = out.size() - z.avail_out;
+      if (n && !emit(out, n)) {
+        inflateEnd(&z);
+        return true;
+      }
+      // Concatenated gzip members, keep going with the next one
+      if (ret == Z_STREAM_END) {
+        inflateReset(&z);
+        in_member = z.avail_in > 0;
+      }
+    } while (z.avail_in > 0 || z.avail_out == 0);
+  }
+  inflateEnd(&z);
+  return ok;
+}
+
+bool DecompressBuf::decodeXz() {
+  vector<char> in(CHUNK_SIZE), out(CHUNK_SIZE);
+  lzma_stream z = LZMA_STREAM_INIT;
+  if (lzma_stream_decoder(&z, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    return false;
+  lzma_action action = LZMA_RUN;
+  bool ok = true;
+  while (ok) {
+    if (z.avail_in == 0 && action == LZMA_RUN) {
+      z.next_in = (uint8_t *)in.data();
+      z.avail_in = fread(in.data(), 1, in.size(), f);
+      if (z.avail_in == 0) action = LZMA_FINISH;
+    }
+    z.next_out = (uint8_t *)out.data();
+    z.avail_out = out.size();
+    lzma_ret ret = lzma_code(&z, action);
+    size_t n = out.size() - z.avail_out;
+    if (n && !emit(out, n)) break;
+    if (ret == LZMA_STREAM_END) break;
+    if (ret != LZMA_OK) ok = false;
+  }
+  lzma_end(&z);
+  return ok;
+}
+
+bool DecompressBuf::decodeBzip2() {
+  vector<char> in(CHUNK_SIZE), out(CHUNK_SIZE);
+  bz_stream z = {};
+  if (BZ2_bzDecompressInit(&z, 0, 0) != BZ_OK) return false;
+  bool ok = true, in_stream = false;
+  while (ok) {
+    z.next_in = in.data();
+    z.avail_in = fread(in.data(), 1, in.size(), f);
+    if (z.avail_in == 0) {
+      ok = !in_stream;  // truncated input
+      break;
+    }
+    in_stream = true;
+    do {
+      z.next_out = out.data();
+      z.avail_out = out.size();
+      int ret = BZ2_bzDecompress(&z);
+      if (ret != BZ_OK && ret != BZ_STREAM_END) {
+        ok = false;
+        break;
+      }
+      size_t n = out.size() - z.avail_out;
+      if (n && !emit(out, n)) {
+        BZ2_bzDecompressEnd(&z);
+        return true;
+      }
+      // Concatenated streams (pbzip2 output), restart the decoder
+      if (ret == BZ_STREAM_END) {
+        BZ2_bzDecompressEnd(&z);
+        if (BZ2_bzDecompressInit(&z, 0, 0) != BZ_OK) return false;
+        in_stream = z.avail_in > 0;
+      }
+    } while (z.avail_in > 0 || z.avail_out == 0);
+  }
+  BZ2_bzDecompressEnd(&z);
+  return ok;
+}
+
+class DecompressStream : public istream {
+ public:
+  DecompressStream(FILE *f, Format format) : istream(nullptr), buf(f, format) {
+    rdbuf(&buf);
+  }
+
+ private:
+  DecompressBuf buf;
+};
+
+// Opens a DIMACS file for parsing. gzip, xz and bzip2 input is recognised by
+// its magic bytes and decompressed on the fly. Returns nullptr if infile
+// can't be opened.
+unique_ptr<istream> openInput(string infile) {
+  FILE *f = fopen(infile.c_str(), "rb");
+  if (!f) return nullptr;
+  Format format = detectFormat(f);
+  if (format == Plain) {
+    fclose(f);
+    return unique_ptr<istream>(new ifstream(infile));
+  }
+  return unique_ptr<istream>(new DecompressStream(f, format));
+}
+
+// For a stream from openInput(), whether decompressing it failed, with error
+// set to why. Reads the rest of the stream first: a truncated file or a bad
+// checksum only shows once the decoder gets to the end.
+bool inputFailed(istream &in, string &error) {
+  auto *buf = dynamic_cast<DecompressBuf *>(in.rdbuf());
+  if (!buf) return false;
+  in.clear();
+  in.ignore(numeric_limits<streamsize>::max());
+  return buf->failed(error);
+}
+
+// Whether infile is gzip, xz or bzip2 rather than plain text
+bool isCompressed(string infile) {
+  FILE *f = fopen(infile.c_str(), "rb");
+  if (!f) return false;
+  Format format = detectFormat(f);
+  fclose(f);
+  return format != Plain;
+}
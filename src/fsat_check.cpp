@@ -0,0 +1,44 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "check.h"
+
+using namespace std;
+
+// Checks a model (a solver's v lines, or bare literals) against the
+// original formula, independently of any solver. Prints "s VERIFIED" and
+// exits 0 if every clause is satisfied, exits 1 with the reason otherwise.
+int main(int argc, char *argv[]) {
+  int threads = max(1u, thread::hardware_concurrency());
+  for (int i = 1; i < argc - 2; i++) {
+    string arg = argv[i];
+    if (arg.rfind("--threads=", 0) == 0)
+      threads = atoi(arg.c_str() + strlen("--threads="));
+    else
+      argc = 0;
+  }
+  if (argc < 3 || threads < 1) {
+    cerr << "Error: incorrect usage. Expected: ./fsat-check [--threads=k] "
+            "model.txt filename.cnf"
+         << endl;
+    exit(0);
+  }
+
+  auto start = chrono::steady_clock::now();
+  PackedModel model;
+  string error;
+  if (!readModel(argv[argc - 2], model, error) ||
+      !checkModelFile(argv[argc - 1], model, threads, error)) {
+    cerr << "Error: " << error << endl;
+    exit(1);
+  }
+  cout << "s VERIFIED" << endl;
+  cerr << "c check time: "
+       << chrono::duration<double>(chrono::steady_clock::now() - start)
+              .count()
+       << " s" << endl;
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "daemon.h"
+
+using namespace std;
+
+unique_ptr<istream> openInput(string infile);
+bool inputFailed(istream &in, string &error);
+
+// Stand-in client for fsatd: sends each file as one job over a single
+// connection and prints the daemon's answer under the file name.
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    cerr << "Error: incorrect usage. Expected: ./a.out socket filename.cnf..."
+         << endl;
+    exit(0);
+  }
+  int fd = connectDaemon(argv[1]);
+  if (fd < 0) {
+    cerr << "Error: couldn't connect to " << argv[1] << endl;
+    exit(1);
+  }
+  string job, response;
+  for (int i = 2; i < argc; i++) {
+    unique_ptr<istream> in = openInput(argv[i]);
+    if (!in) {
+      cerr << "Error: couldn't open file " << argv[i] << endl;
+      continue;
+    }
+    job.assign(istreambuf_iterator<char>(*in), istreambuf_iterator<char>());
+    string error;
+    if (inputFailed(*in, error)) {
+      cerr << "Error: " << argv[i] << ": " << error << endl;
+      continue;
+    }
+    auto start = chrono::steady_clock::now();
+    if (!sendFrame(fd, job) || !recvFrame(fd, response)) {
+      cerr << "Error: lost connection to " << argv[1] << endl;
+      exit(1);
+    }
+    cout << "c file: " << argv[i] << "\n" << response;
+    cout << "c round trip: "
+         << chrono::duration<double>(chrono::steady_clock::now() - start)
+                .count()
+         << " s" << endl;
+  }
+  close(fd);
+  return 0;
+}
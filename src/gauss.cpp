@@ -0,0 +1,226 @@
+#include "gauss.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace std;
+
+void findXors(const CNF &cnf, vector<Xor> &xors) {
+  xors.clear();
+  // Candidates as sorted variables in vars[begin..begin + size) plus which
+  // of them are negated, bit i for the i-th
+  struct Candidate {
+    unsigned begin;
+    int size;
+    unsigned negated;
+  };
+  vector<int> vars;
+  vector<Candidate> cands;
+  for (int c = 0; c < cnf.clause_cnt; c++) {
+    const int *clause = cnf.lits + cnf.offsets[c];
+    int size = cnf.offsets[c + 1] - cnf.offsets[c];
+    if (size < 3 || size > MAX_XOR_VARS) continue;
+    int lits[MAX_XOR_VARS];
+    copy(clause, clause + size, lits);
+    sort(lits, lits + size,
+         [](int a, int b) { return abs(a) < abs(b); });
+    bool repeated = false;
+    unsigned negated = 0;
+    for (int i = 0; i < size; i++) {
+      if (i > 0 && abs(lits[i]) == abs(lits[i - 1])) repeated = true;
+      if (lits[i] < 0) negated |= 1u << i;
+    }
+    if (repeated) continue;
+    cands.push_back({(unsigned)vars.size(), size, negated});
+    for (int i = 0; i < size; i++) vars.push_back(abs(lits[i]));
+  }
+  auto sameVars = [&](const Candidate &a, const Candidate &b) {
+    return a.size == b.size && equal(vars.begin() + a.begin,
+                                     vars.begin() + a.begin + a.size,
+                                     vars.begin() + b.begin);
+  };
+  sort(cands.begin(), cands.end(),
+       [&](const Candidate &a, const Candidate &b) {
+         if (a.size != b.size) return a.size < b.size;
+         return lexicographical_compare(
+             vars.begin() + a.begin, vars.begin() + a.begin + a.size,
+             vars.begin() + b.begin, vars.begin() + b.begin + b.size);
+       });
+
+  for (size_t i = 0, j; i < cands.size(); i = j) {
+    // Which sign patterns show up over these variables
+    unsigned long long seen = 0;
+    for (j = i; j < cands.size() && sameVars(cands[i], cands[j]); j++)
+      seen |= 1ULL << cands[j].negated;
+    int k = cands[i].size;
+    // A clause rules out the assignment making it false, which has the
+    // negated variables true. So all of them with an even (odd) number
+    // negated rule out every even (odd) assignment, leaving sum = 1 (0).
+    unsigned long long even = 0;
+    for (unsigned p = 0; p < (1u << k); p++)
+      if (__builtin_popcount(p) % 2 == 0) even |= 1ULL << p;
+    unsigned long long all = k == 6 ? ~0ULL : (1ULL << (1 << k)) - 1;
+    for (int odd = 0; odd < 2; odd++) {
+      unsigned long long want = odd ? all & ~even : even;
+      if ((seen & want) != want) continue;
+      const Candidate &c = cands[i];
+      xors.push_back({vector<int>(vars.begin() + c.begin,
+                                  vars.begin() + c.begin + k),
+                      !odd});
+    }
+  }
+}
+
+bool Gauss::init(Arena &arena, const vector<Xor> &xors, int var_cnt) {
+  row_cnt = col_cnt = words = 0;
+  elim_cnt = 0;
+  vector<int> cols(var_cnt + 1, -1), vars;
+  for (const Xor &x : xors)
+    for (int v : x.vars)
+      if (cols[v] == -1) {
+        cols[v] = vars.size();
+        vars.push_back(v);
+      }
+  int word_cnt = (vars.size() + 63) / 64;
+  if (xors.empty() || (long long)xors.size() * word_cnt * 64 > MAX_BITS)
+    return false;
+  row_cnt = xors.size();
+  col_cnt = vars.size();
+  words = word_cnt;
+
+  col_of = arena.alloc<int>(var_cnt + 1);
+  copy(cols.begin(), cols.end(), col_of);
+  var_of = arena.alloc<int>(col_cnt);
+  copy(vars.begin(), vars.end(), var_of);
+  bits = arena.alloc<unsigned long long>((long long)row_cnt * words);
+  memset(bits, 0, sizeof(*bits) * row_cnt * words);
+  rhs = arena.alloc<char>(row_cnt);
+  basic = arena.alloc<int>(row_cnt);
+  basic_row = arena.alloc<int>(col_cnt);
+  fill(basic_row, basic_row + col_cnt, -1);
+  assigned = arena.alloc<unsigned long long>(words);
+  value = arena.alloc<unsigned long long>(words);
+  pending.init(arena, row_cnt);
+  in_pending = arena.alloc<char>(row_cnt);
+  memset(in_pending, 0, row_cnt);
+  for (int r = 0; r < row_cnt; r++) {
+    for (int v : xors[r].vars)
+      row(r)[col_of[v] >> 6] |= 1ULL << (col_of[v] & 63);
+    rhs[r] = xors[r].rhs;
+    basic[r] = -1;
+  }
+
+  // Gauss-Jordan, a row left empty is either redundant or (rhs 1) makes the
+  // whole system unsatisfiable
+  for (int r = 0; r < row_cnt; r++)
+    for (int i = 0; i < words; i++)
+      if (row(r)[i]) {
+        pivot(r, i * 64 + __builtin_ctzll(row(r)[i]));
+        break;
+      }
+  reset();
+  return true;
+}
+
+void Gauss::reset() {
+  if (row_cnt == 0) return;
+  memset(assigned, 0, sizeof(*assigned) * words);
+  memset(value, 0, sizeof(*value) * words);
+  head = 0;
+  conflicted = false;
+  pending.clear();
+  memset(in_pending, 0, row_cnt);
+  for (int r = 0; r < row_cnt; r++) addPending(r);
+}
+
+void Gauss::addPending(int r) {
+  if (in_pending[r]) return;
+  in_pending[r] = 1;
+  pending.push_back(r);
+}
+
+// Makes col the basic variable of row r and eliminates it from the others
+void Gauss::pivot(int r, int col) {
+  if (basic[r] >= 0) basic_row[basic[r]] = -1;
+  basic[r] = col;
+  basic_row[col] = r;
+  int w = col >> 6;
+  unsigned long long bit = 1ULL << (col & 63);
+  const unsigned long long *src = row(r);
+  for (int s = 0; s < row_cnt; s++) {
+    unsigned long long *dst = row(s);
+    if (s == r || !(dst[w] & bit)) continue;
+    for (int i = 0; i < words; i++) dst[i] ^= src[i];
+    rhs[s] ^= rhs[r];
+    elim_cnt++;
+    addPending(s);
+  }
+}
+
+int Gauss::propagate(const Stack<int> &trail) {
+  if (row_cnt == 0 || conflicted) return 0;
+  for (; head < trail.size(); head++) {
+    int lit = trail[head];
+    int col = col_of[lit < 0 ? -lit : lit];
+    if (col < 0) continue;
+    int w = col >> 6;
+    unsigned long long bit = 1ULL << (col & 63);
+    assigned[w] |= bit;
+    if (lit > 0)
+      value[w] |= bit;
+    else
+      value[w] &= ~bit;
+    // A row whose basic variable got assigned hands over to another
+    // unassigned one, if it has any left
+    int r = basic_row[col];
+    if (r >= 0)
+      for (int i = 0; i < words; i++) {
+        unsigned long long free = row(r)[i] & ~assigned[i];
+        if (free) {
+          pivot(r, i * 64 + __builtin_ctzll(free));
+          break;
+        }
+      }
+    for (int s = 0; s < row_cnt; s++)
+      if (row(s)[w] & bit) addPending(s);
+  }
+
+  while (!pending.empty()) {
+    int r = pending.back();
+    pending.pop_back();
+    in_pending[r] = 0;
+    const unsigned long long *bits_r = row(r);
+    int free_cnt = 0, free_col = -1;
+    int parity = rhs[r];
+    for (int i = 0; i < words && free_cnt < 2; i++) {
+      unsigned long long free = bits_r[i] & ~assigned[i];
+      if (free) {
+        free_cnt += __builtin_popcountll(free);
+        free_col = i * 64 + __builtin_ctzll(free);
+      }
+      parity ^= __builtin_popcountll(bits_r[i] & assigned[i] & value[i]) & 1;
+    }
+    if (free_cnt >= 2) continue;
+    if (free_cnt == 1) return parity ? var_of[free_col] : -var_of[free_col];
+    if (parity) {
+      conflicted = true;
+      return 0;
+    }
+  }
+  return 0;
+}
+
+void Gauss::undo(const Stack<int> &trail, unsigned mark) {
+  if (row_cnt == 0) return;
+  for (unsigned i = mark; i < head; i++) {
+    int col = col_of[trail[i] < 0 ? -trail[i] : trail[i]];
+    if (col >= 0) assigned[col >> 6] &= ~(1ULL << (col & 63));
+  }
+  head = min(head, mark);
+  conflicted = false;
+  while (!pending.empty()) {
+    in_pending[pending.back()] = 0;
+    pending.pop_back();
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef GAUSS_H
+#define GAUSS_H
+
+#include <vector>
+
+#include "arena.h"
+#include "cnf.h"
+
+// Longest XOR findXors() looks for, one takes 2^(k-1) clauses
+#define MAX_XOR_VARS 6
+
+// x_1 + ... + x_k = rhs over GF(2), vars sorted and distinct
+struct Xor {
+  std::vector<int> vars;
+  bool rhs;
+};
+
+// Recovers XORs of 3 to MAX_XOR_VARS variables from their direct encoding:
+// all 2^(k-1) clauses over the same variables whose number of negated
+// literals has the same parity. The clauses themselves stay in cnf.
+void findXors(const CNF &cnf, std::vector<Xor> &xors);
+
+// The XORs as a GF(2) matrix with a row of bits per XOR, propagated
+// alongside the clauses.
+//
+// Every row has a basic variable that appears in no other row. When the
+// basic variable of a row is assigned, another unassigned variable of the
+// row takes its place and is eliminated from every other row, so the
+// matrix stays in reduced row echelon form over the unassigned variables.
+// That makes propagation complete: a literal follows from the XORs and the
+// assignment exactly when some row has only it left unassigned, and they
+// conflict exactly when some row has nothing left and the wrong parity.
+// Row operations keep the same solutions whatever is assigned, so
+// backtracking only unassigns and never has to restore rows.
+class Gauss {
+ public:
+  // Lays the matrix out in arena and eliminates once up front. Returns false
+  // (and stays empty) if it would take more than MAX_BITS bits.
+  static const long long MAX_BITS = 1LL << 24;
+  bool init(Arena &arena, const std::vector<Xor> &xors, int var_cnt);
+  // Nothing assigned, for a new solve
+  void reset();
+  // Takes in trail[head..] and returns a literal implied by the XORs, or 0
+  // if there is none or conflict() has been set
+  int propagate(const Stack<int> &trail);
+  // Call before the trail is cut back to mark
+  void undo(const Stack<int> &trail, unsigned mark);
+  bool conflict() const { return conflicted; }
+  int rows() const { return row_cnt; }
+  int cols() const { return col_cnt; }
+  long long eliminations() const { return elim_cnt; }
+
+ private:
+  int row_cnt = 0, col_cnt = 0, words = 0;
+  unsigned long long *bits = nullptr;  // row r at bits + r * words
+  char *rhs = nullptr;
+  int *basic = nullptr;     // per row, its basic column or -1 if it is empty
+  int *basic_row = nullptr; // per column, the row it is basic in or -1
+  int *col_of = nullptr;    // per var, its column or -1
+  int *var_of = nullptr;    // per column, its var
+  // Per column, as far as the trail has been taken in
+  unsigned long long *assigned = nullptr, *value = nullptr;
+  unsigned head = 0;
+  bool conflicted = false;
+  // Rows to check for an implication or conflict
+  Stack<int> pending;
+  char *in_pending = nullptr;
+  long long elim_cnt = 0;
+
+  unsigned long long *row(int r) const { return bits + (long long)r * words; }
+  void addPending(int r);
+  void pivot(int r, int col);
+};
+
+#endif
@@ -8,10 +8,16 @@
 
 #include <CL/cl2.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
+#include "cnf.h"
+#include "daemon.h"
+
 using namespace std;
 
 std::vector<cl::Device> get_xilinx_devices() {
@@ -64,11 +70,11 @@ enum Status {
 class SATInstance {
  public:
   int var_cnt = 0, clause_cnt = 0;
-  // -1 (unassigned), 0 (false), 1 (true)
-  vector<int> vars = {};
+  // -1 (unassigned), 0 (false), 1 (true), a byte each as in the kernels
+  vector<signed char> vars = {};
   vector<vector<int>> clauses = {};
 
-  int *in, *out;
+  signed char *in, *out;
   cl::Kernel *krnl;
   cl::Buffer *in_buf, *out_buf;
   cl::CommandQueue *q;
@@ -77,46 +83,34 @@ class SATInstance {
   void runStuff();
 
   void read(string infile);
+  void load(const CNF &cnf);
   Status solve();
   Status backtrack();
   vector<int> resolveImplications();
   int getImpliedVar();
   bool conflictExists();
   int selectVar();
-  void printSol();
+  void printSol(ostream &out = cout);
   void printClauses();
 };
 
 static int mod(int x) { return x < 0 ? -x : x; }
 
 void SATInstance::read(string infile) {
-  ifstream fin(infile);
-  if (!fin.is_open()) {
-    cerr << "Error: couldn't open file " << infile << endl;
-    exit(0);
-  }
-  char c;  // check if line is comment
-  string s;
-  while (true) {
-    fin >> c;
-    if (c == 'c')
-      getline(fin, s);
-    else
-      break;
-  }
-  fin >> s;
-  if (s != "cnf") {
-    cerr << "Error: expected cnf input file, given " << s << endl;
-    exit(1);
-  }
-  fin >> var_cnt >> clause_cnt;
+  CNF cnf;
+  readDIMACS(infile, cnf);
+  load(cnf);
+}
+
+void SATInstance::load(const CNF &cnf) {
+  var_cnt = cnf.var_cnt;
+  clause_cnt = cnf.clause_cnt;
   vars.clear();
   vars.resize(var_cnt + 1);
   clauses.clear();
   clauses.resize(clause_cnt);
-  int var;
   for (int i = 0; i < clause_cnt; i++)
-    for (fin >> var; var != 0; fin >> var) clauses[i].push_back(var);
+    clauses[i].assign(cnf.lits + cnf.offsets[i], cnf.lits + cnf.offsets[i + 1]);
 }
 
 Status SATInstance::solve() {
@@ -206,11 +200,11 @@ bool SATInstance::conflictExists() {
   return false;
 }
 
-void SATInstance::printSol() {
-  cout << "s SATISFIABLE" << endl;
-  cout << "v ";
-  for (int i = 1; i <= var_cnt; i++) cout << (vars[i] ? i : -i) << " ";
-  cout << endl;
+void SATInstance::printSol(ostream &out) {
+  out << "s SATISFIABLE" << endl;
+  out << "v ";
+  for (int i = 1; i <= var_cnt; i++) out << (vars[i] ? i : -i) << " ";
+  out << endl;
 }
 
 void SATInstance::printClauses() {
@@ -232,25 +226,73 @@ void SATInstance::runKrnl() {
 }
 
 void SATInstance::runStuff() {
-  for (unsigned i = 0, e = vars.size(); i < e; ++i) in[i] = vars[i];
-  for (unsigned i = 0, e = vars.size(); i < e; ++i) cout << in[i] << " ";
+  memcpy(in, vars.data(), vars.size());
+  for (unsigned i = 0, e = vars.size(); i < e; ++i) cout << (int)in[i] << " ";
   cout << "\n";
   runKrnl();
-  for (unsigned i = 0, e = vars.size(); i < e; ++i) cout << out[i] << " ";
+  for (unsigned i = 0, e = vars.size(); i < e; ++i) cout << (int)out[i] << " ";
   cout << "\n";
 }
 
+// Device buffers for vars, kept across the jobs of a daemon and only
+// reallocated for an instance with more variables than any before it
+struct HostBuffers {
+  cl::Buffer in_buf, out_buf;
+  signed char *in = nullptr, *out = nullptr;
+  size_t cap = 0;
+};
+
+// Step 2 for one instance: create (or reuse) the buffers and hand them and
+// the instance size to the kernel
+static void bindBuffers(SATInstance &s, cl::Context &context,
+                        cl::CommandQueue &q, cl::Kernel &krnl,
+                        HostBuffers &bufs) {
+  cl_int err;
+  size_t size = s.vars.size();
+  if (bufs.cap < size) {
+    if (bufs.in) q.enqueueUnmapMemObject(bufs.in_buf, bufs.in);
+    if (bufs.out) q.enqueueUnmapMemObject(bufs.out_buf, bufs.out);
+    // Create the buffers and allocate memory, a byte per variable
+    bufs.in_buf = cl::Buffer(context, CL_MEM_READ_ONLY, size, NULL, &err);
+    bufs.out_buf = cl::Buffer(context, CL_MEM_WRITE_ONLY, size, NULL, &err);
+    // Map host-side buffer memory to user-space pointers
+    bufs.in = (signed char *)q.enqueueMapBuffer(bufs.in_buf, CL_TRUE,
+                                                CL_MAP_READ, 0, size);
+    bufs.out = (signed char *)q.enqueueMapBuffer(bufs.out_buf, CL_TRUE,
+                                                 CL_MAP_WRITE, 0, size);
+    bufs.cap = size;
+  }
+
+  // Set kernel arguments
+  krnl.setArg(0, bufs.in_buf);
+  krnl.setArg(1, bufs.out_buf);
+  krnl.setArg(2, s.var_cnt);
+
+  s.in = bufs.in;
+  s.out = bufs.out;
+  s.krnl = &krnl;
+  s.q = &q;
+  s.in_buf = &bufs.in_buf;
+  s.out_buf = &bufs.out_buf;
+}
+
 int main(int argc, char *argv[]) {
   if (argc != 4) {
     cerr << "Error: incorrect usage. Expected: ./a.out kernal_file kernal_name "
-            "filename.cnf"
+            "filename.cnf\n"
+            "   or: ./a.out kernal_file kernal_name --daemon=socket"
          << endl;
     exit(0);
   }
+  string arg = argv[3], socket_path;
+  if (arg.rfind("--daemon=", 0) == 0)
+    socket_path = arg.substr(strlen("--daemon="));
 
   SATInstance s;
-  s.read(argv[3]);
-  cerr << "Loaded SAT\n";
+  if (socket_path.empty()) {
+    s.read(argv[3]);
+    cerr << "Loaded SAT\n";
+  }
 
   // ------------------------------------------------------------------------------------
   // Step 1: Initialize the OpenCL environment
@@ -267,42 +309,46 @@ int main(int argc, char *argv[]) {
   cl::Program program(context, devices, bins, NULL, &err);
   cl::CommandQueue q(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
   cl::Kernel krnl(program, argv[2], &err);
+  HostBuffers bufs;
+
+  if (!socket_path.empty()) {
+    // fsatd mode: the device is set up once above and every job reuses it,
+    // see daemon.h for the protocol
+    serve(socket_path, [&](const string &job) {
+      ostringstream out;
+      auto start = chrono::steady_clock::now();
+      istringstream in(job);
+      CNF cnf;
+      string error;
+      if (!parseDIMACS(in, cnf, error)) {
+        out << "c error: " << error << "\n";
+        return out.str();
+      }
+      SATInstance js;
+      js.load(cnf);
+      bindBuffers(js, context, q, krnl, bufs);
+      auto solve_start = chrono::steady_clock::now();
+      if (js.solve() == Solved)
+        js.printSol(out);
+      else
+        out << "UNSATISFIABLE" << "\n";
+      auto end = chrono::steady_clock::now();
+      out << "c parse time: "
+          << chrono::duration<double>(solve_start - start).count() << " s\n";
+      out << "c solve time: "
+          << chrono::duration<double>(end - solve_start).count() << " s\n";
+      return out.str();
+    });
+  }
 
   // ------------------------------------------------------------------------------------
   // Step 2: Create buffers and initialize test values
   // ------------------------------------------------------------------------------------
-  // Create the buffers and allocate memory
-  cl::Buffer in_buf(context, CL_MEM_READ_ONLY, sizeof(int) * s.vars.size(),
-                    NULL, &err);
-  cl::Buffer out_buf(context, CL_MEM_WRITE_ONLY, sizeof(int) * s.vars.size(),
-                     NULL, &err);
-
-  // Map buffers to kernel arguments, thereby assigning them to specific device
-  // memory banks
-  krnl.setArg(0, in_buf);
-  krnl.setArg(1, out_buf);
-
-  // Map host-side buffer memory to user-space pointers
-  int *in = (int *)q.enqueueMapBuffer(in_buf, CL_TRUE, CL_MAP_READ, 0,
-                                      sizeof(int) * s.vars.size());
-  int *out = (int *)q.enqueueMapBuffer(out_buf, CL_TRUE, CL_MAP_WRITE, 0,
-                                       sizeof(int) * s.vars.size());
+  bindBuffers(s, context, q, krnl, bufs);
 
   // ------------------------------------------------------------------------------------
   // Step 3: Run the kernel
   // ------------------------------------------------------------------------------------
-  // Set kernel arguments
-  krnl.setArg(0, in_buf);
-  krnl.setArg(1, out_buf);
-  krnl.setArg(2, s.var_cnt);
-
-  s.in = in;
-  s.out = out;
-  s.krnl = &krnl;
-  s.q = &q;
-  s.in_buf = &in_buf;
-  s.out_buf = &out_buf;
-
   cerr << "solving now\n";
 
   if (s.solve() == Solved)
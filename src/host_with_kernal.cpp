@@ -8,12 +8,26 @@
 
 #include <CL/cl2.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <vector>
 
+#include "check.h"
+#include "cnf.h"
+#include "daemon.h"
+#include "scheduler.h"
+
 using namespace std;
 
+// The kernel compiled for the host, the CPU side of --hybrid
+void kernal(int *clauses, signed char *out, int *reasons, int var_cnt,
+            int clause_cnt);
+
 std::vector<cl::Device> get_xilinx_devices() {
   size_t i;
   cl_int err;
@@ -64,69 +78,113 @@ enum Status {
 class SATInstance {
  public:
   int var_cnt = 0, clause_cnt = 0;
-  // -1 (unassigned), 0 (false), 1 (true)
-  vector<int> vars = {};
+  // -1 (unassigned), 0 (false), 1 (true), a byte each as in the kernel
+  vector<signed char> vars = {};
   vector<int> clauses = {};
+  // The kernel's conflict clause and implications with their clauses, laid
+  // out as described in kernal.cpp
+  vector<int> reasons = {};
+  // Assigned variables in assignment order, backtracking unwinds these
+  // instead of restoring a per node copy of vars. Sized by load().
+  vector<int> trail = {};
+  // Kept around so a mapped cache can back clause_buf directly
+  CNF cnf;
+  // Original number of each variable if --reorder renumbered them, empty
+  // otherwise
+  bool reorder = false;
+  vector<int> var_order = {};
 
-  int *out, *clause;
+  signed char *out;
+  int *clause, *reason;
   cl::Kernel *krnl;
-  cl::Buffer *out_buf, *clause_buf;
+  cl::Buffer *out_buf, *clause_buf, *reason_buf;
   cl::CommandQueue *q;
 
+  // Clause sharding: shard k owns clauses [shard_begin[k], shard_begin[k + 1])
+  // and runs on compute unit kernal_<k + 1> with its own queue and buffers
+  int shard_cnt = 1;
+  vector<int> shard_begin = {};
+  vector<cl::Kernel> shard_krnls = {};
+  vector<cl::CommandQueue> shard_qs = {};
+  vector<cl::Buffer> shard_clause_bufs = {}, shard_out_bufs = {},
+                     shard_reason_bufs = {};
+  vector<signed char *> shard_outs = {};
+  vector<int *> shard_reasons = {};
+
+  // --hybrid: each call goes to whichever of the device and kernal() on the
+  // active clauses on the host hybrid predicts to be faster. Set up by
+  // load().
+  bool use_hybrid = false;
+  unique_ptr<HybridScheduler> hybrid;
+  // Decisions on the current path
+  int depth = 0;
+  vector<int> active_lits = {}, active_index = {};
+
   void runKernal();
+  void runDevice();
+  void setupShards(int k, cl::Context &context, cl::Device &device,
+                   cl::Program &program);
+  void runSharded();
 
-  void read(string infile);
+  void read(string infile, bool use_cache = false, bool revalidate = false);
+  bool load(string &error);
   Status solve();
   Status backtrack();
+  void recordAssigned();
+  void undo(unsigned mark);
   int getImpliedVar();
   int selectVar();
-  void printSol();
+  void printSol(ostream &out = cout);
   void printClauses();
 };
 
 static int mod(int x) { return x < 0 ? -x : x; }
 
-void SATInstance::read(string infile) {
-  ifstream fin(infile);
-  if (!fin.is_open()) {
-    cerr << "Error: couldn't open file " << infile << endl;
-    exit(0);
-  }
-  char c;  // check if line is comment
-  string s;
-  while (true) {
-    fin >> c;
-    if (c == 'c')
-      getline(fin, s);
-    else
-      break;
-  }
-  fin >> s;
-  if (s != "cnf") {
-    cerr << "Error: expected cnf input file, given " << s << endl;
+void SATInstance::read(string infile, bool use_cache, bool revalidate) {
+  if (use_cache)
+    readCached(infile, cnf, revalidate);
+  else
+    readDIMACS(infile, cnf);
+  string error;
+  if (!load(error)) {
+    cerr << "Error: " << error << endl;
     exit(1);
   }
-  fin >> var_cnt >> clause_cnt;
+}
+
+// Set up the solver for whatever is in cnf, false (with error set) if the
+// kernel can't take it
+bool SATInstance::load(string &error) {
+  var_order.clear();
+  // Drops a mapped cache, clause_buf then gets a copy as usual
+  if (reorder) reorderCNF(cnf, var_order);
+  var_cnt = cnf.var_cnt;
+  clause_cnt = cnf.clause_cnt;
   vars.clear();
   vars.resize(var_cnt + 1, 0);
-  clauses.clear();
-  int var;
-  for (int i = 0; i < clause_cnt; i++)
-    for (fin >> var; var != 0; fin >> var) clauses.push_back(var);
+  if (!kernelClauses(cnf, clauses, error)) return false;
+  reasons.assign(2 * var_cnt + 2, 0);
+  trail.clear();
+  trail.reserve(var_cnt);
+  hybrid.reset(use_hybrid ? new HybridScheduler(var_cnt, clause_cnt)
+                          : nullptr);
+  return true;
 }
 
 Status SATInstance::solve() {
   for (int i = 1; i <= var_cnt; i++) vars[i] = -1;
+  undo(0);
   return backtrack();
 }
 
 Status SATInstance::backtrack() {
-  vector<int> curr = vars;
+  unsigned mark = trail.size();
   runKernal();
+  recordAssigned();
   if (vars[0]) {
     // Current (partial) assignment causes conflict, undo implications and
     // backtrack
-    vars = curr;
+    undo(mark);
     return Unsolvable;
   }
   int var = selectVar();
@@ -134,6 +192,8 @@ Status SATInstance::backtrack() {
     return Solved;  // All variables are assigned with no conflict, we are done
   // Try to recurse by assigning current var false
   vars[var] = 0;
+  trail.push_back(var);
+  depth++;
   Status s = backtrack();
   if (s == Solved)
     return Solved;  // Yay! False for current var worked!
@@ -145,12 +205,29 @@ Status SATInstance::backtrack() {
       return Solved;  // Yay! True for current var worked!
     else {
       // Both didn't work, backtrack by leaving current var unassigned
-      vars = curr;
+      depth--;
+      undo(mark);
       return Unsolvable;
     }
   }
 }
 
+// The kernel lists what it implied in order, so that goes on the trail as
+// is. Decisions are put there by backtrack().
+void SATInstance::recordAssigned() {
+  for (int i = 0; i < reasons[1]; i++)
+    trail.push_back(mod(reasons[2 + 2 * i]));
+}
+
+// Unassigns everything put on the trail after mark
+void SATInstance::undo(unsigned mark) {
+  while (trail.size() > mark) {
+    vars[trail.back()] = -1;
+    trail.pop_back();
+  }
+  vars[0] = 0;
+}
+
 // Select next variable to try, insert any heuristics if desired
 int SATInstance::selectVar() {
   for (int i = 1; i <= var_cnt; i++)
@@ -158,36 +235,317 @@ int SATInstance::selectVar() {
   return var_cnt + 1;
 }
 
-void SATInstance::printSol() {
-  cout << "s SATISFIABLE" << endl;
-  cout << "v ";
-  for (int i = 1; i <= var_cnt; i++) cout << (vars[i] ? i : -i) << " ";
-  cout << endl;
+void SATInstance::printSol(ostream &out) {
+  out << "s SATISFIABLE" << endl;
+  out << "v ";
+  // Back in input numbering
+  vector<signed char> model = vars;
+  for (int i = 1; i <= var_cnt && !var_order.empty(); i++)
+    model[var_order[i]] = vars[i];
+  for (int i = 1; i <= var_cnt; i++) out << (model[i] ? i : -i) << " ";
+  out << endl;
 }
 
 void SATInstance::runKernal() {
+  if (!hybrid) {
+    runDevice();
+    return;
+  }
+  Backend b = hybrid->route(depth);
+  auto start = chrono::steady_clock::now();
+  int active = -1;
+  if (b == Cpu)
+    active = propagateActive(
+        [this](const int *cls, int cnt, signed char *out, int *r) {
+          kernal((int *)cls, out, r, var_cnt, cnt);
+        },
+        clauses.data(), clause_cnt, vars.data(), reasons.data(), active_lits,
+        active_index);
+  else
+    runDevice();
+  hybrid->record(
+      b, depth,
+      chrono::duration<double, nano>(chrono::steady_clock::now() - start)
+          .count(),
+      active);
+}
+
+void SATInstance::runDevice() {
+  if (shard_cnt > 1) {
+    runSharded();
+    return;
+  }
   // Schedule transfer of inputs to device memory, execution of kernel, and
   // transfer of outputs back to host memory
-  for (unsigned i = 0, e = vars.size(); i < e; ++i)
-    out[i] = vars[i];
+  memcpy(out, vars.data(), vars.size());
   q->enqueueMigrateMemObjects({*clause_buf, *out_buf}, 0 /* 0 means from host*/);
   q->enqueueTask(*krnl);
-  q->enqueueMigrateMemObjects({*out_buf}, CL_MIGRATE_MEM_OBJECT_HOST);
+  q->enqueueMigrateMemObjects({*out_buf, *reason_buf},
+                              CL_MIGRATE_MEM_OBJECT_HOST);
   q->finish();
-  for (unsigned i = 0, e = vars.size(); i < e; ++i)
-    vars[i] = out[i];
+  memcpy(vars.data(), out, vars.size());
+  copy(reason, reason + 2 + 2 * reason[1], reasons.begin());
+}
+
+void SATInstance::setupShards(int k, cl::Context &context, cl::Device &device,
+                              cl::Program &program) {
+  cl_int err;
+  shard_cnt = max(1, min(k, clause_cnt));
+  shard_begin.resize(shard_cnt + 1);
+  for (int i = 0; i <= shard_cnt; i++)
+    shard_begin[i] = (long long)clause_cnt * i / shard_cnt;
+  for (int i = 0; i < shard_cnt; i++) {
+    // Xilinx names the compute units of a kernel kernal_1, kernal_2, ...
+    string cu = "kernal:{kernal_" + to_string(i + 1) + "}";
+    shard_krnls.emplace_back(program, cu.c_str(), &err);
+    shard_qs.emplace_back(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
+    cl::CommandQueue &sq = shard_qs[i];
+
+    // The clauses never change, they go over once here instead of on every
+    // launch
+    size_t lits = 3 * (shard_begin[i + 1] - shard_begin[i]);
+    size_t clause_size = sizeof(int) * max<size_t>(lits, 1);
+    shard_clause_bufs.emplace_back(context, CL_MEM_READ_ONLY, clause_size,
+                                   nullptr, &err);
+    int *shard = (int *)sq.enqueueMapBuffer(shard_clause_bufs[i], CL_TRUE,
+                                            CL_MAP_WRITE, 0, clause_size);
+    copy(clauses.begin() + 3 * shard_begin[i],
+         clauses.begin() + 3 * shard_begin[i + 1], shard);
+    sq.enqueueUnmapMemObject(shard_clause_bufs[i], shard);
+    sq.enqueueMigrateMemObjects({shard_clause_bufs[i]}, 0);
+
+    shard_out_bufs.emplace_back(context, CL_MEM_READ_WRITE, vars.size(),
+                                nullptr, &err);
+    shard_outs.push_back((signed char *)sq.enqueueMapBuffer(
+        shard_out_bufs[i], CL_TRUE, CL_MAP_WRITE | CL_MAP_READ, 0,
+        vars.size()));
+    size_t reason_size = sizeof(int) * reasons.size();
+    shard_reason_bufs.emplace_back(context, CL_MEM_WRITE_ONLY, reason_size,
+                                   nullptr, &err);
+    shard_reasons.push_back((int *)sq.enqueueMapBuffer(
+        shard_reason_bufs[i], CL_TRUE, CL_MAP_READ, 0, reason_size));
+
+    shard_krnls[i].setArg(0, shard_clause_bufs[i]);
+    shard_krnls[i].setArg(1, shard_out_bufs[i]);
+    shard_krnls[i].setArg(2, shard_reason_bufs[i]);
+    shard_krnls[i].setArg(3, var_cnt);
+    shard_krnls[i].setArg(4, shard_begin[i + 1] - shard_begin[i]);
+  }
+  for (auto &sq : shard_qs) sq.finish();
+}
+
+// All compute units propagate their shard against the same assignment
+// concurrently, then the host merges what they implied by replaying each
+// shard's reasons, with the clause indices made global again. An implication
+// from one shard can trigger more in another, so this repeats until a round
+// adds nothing. The last round has every shard check its clauses against the
+// final assignment, so a conflict anywhere is caught.
+void SATInstance::runSharded() {
+  bool changed = true;
+  int conflict = -1, implied_cnt = 0;
+  while (changed && conflict < 0) {
+    changed = false;
+    for (int k = 0; k < shard_cnt; k++) {
+      copy(vars.begin(), vars.end(), shard_outs[k]);
+      shard_qs[k].enqueueMigrateMemObjects({shard_out_bufs[k]}, 0);
+      shard_qs[k].enqueueTask(shard_krnls[k]);
+      shard_qs[k].enqueueMigrateMemObjects(
+          {shard_out_bufs[k], shard_reason_bufs[k]},
+          CL_MIGRATE_MEM_OBJECT_HOST);
+      shard_qs[k].flush();
+    }
+    for (auto &sq : shard_qs) sq.finish();
+    for (int k = 0; k < shard_cnt && conflict < 0; k++) {
+      const int *r = shard_reasons[k];
+      for (int i = 0; i < r[1] && conflict < 0; i++) {
+        int lit = r[2 + 2 * i], var = mod(lit);
+        int clause = shard_begin[k] + r[3 + 2 * i];
+        if (vars[var] == -1) {
+          vars[var] = lit > 0;
+          reasons[2 + 2 * implied_cnt] = lit;
+          reasons[3 + 2 * implied_cnt] = clause;
+          implied_cnt++;
+          changed = true;
+        } else if (vars[var] != (lit > 0))
+          conflict = clause;  // Two shards implied opposite values
+      }
+      // Falsified on the shard's assignment, all of which is in vars now
+      if (conflict < 0 && r[0] >= 0) conflict = shard_begin[k] + r[0];
+    }
+  }
+  vars[0] = conflict >= 0;
+  reasons[0] = conflict;
+  reasons[1] = implied_cnt;
+}
+
+// Device buffers that outlive a single instance. They only ever grow, so a
+// batch or daemon run settles on buffers sized for its largest instance and
+// stops allocating.
+struct DeviceBuffers {
+  cl::Buffer clause_buf, out_buf, reason_buf;
+  int *clause = nullptr, *reason = nullptr;
+  signed char *out = nullptr;
+  size_t clause_cap = 0, var_cap = 0;
+  // clause_buf wraps a mapped cache rather than memory of its own
+  bool host_ptr = false;
+};
+
+// Steps 2 and 3 for one instance, context, program and kernel are set up
+// once by the caller and shared by every instance solved in this process
+static Status solveOnDevice(SATInstance &s, cl::Context &context,
+                            cl::CommandQueue &q, cl::Kernel &krnl,
+                            DeviceBuffers &bufs) {
+  cl_int err;
+  // ------------------------------------------------------------------------------------
+  // Step 2: Create buffers and initialize test values
+  // ------------------------------------------------------------------------------------
+  size_t clause_size = sizeof(int) * max<size_t>(s.clauses.size(), 1);
+  size_t var_size = s.vars.size();
+  // A mapped 3-SAT cache already holds the clauses in kernel layout (and page
+  // aligned), let the runtime use it in place. Anything padded needs a copy.
+  bool in_place =
+      s.cnf.map && s.cnf.litCnt() == 3 * (unsigned)s.clause_cnt;
+  if (in_place || bufs.clause_cap < clause_size) {
+    if (bufs.clause) q.enqueueUnmapMemObject(bufs.clause_buf, bufs.clause);
+    if (in_place) {
+      bufs.clause_buf =
+          cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                     clause_size, (void *)s.cnf.lits, &err);
+      bufs.clause_cap = 0;
+    } else {
+      bufs.clause_buf =
+          cl::Buffer(context, CL_MEM_READ_ONLY, clause_size, NULL, &err);
+      bufs.clause_cap = clause_size;
+    }
+    bufs.host_ptr = in_place;
+    bufs.clause = (int *)q.enqueueMapBuffer(
+        bufs.clause_buf, CL_TRUE, in_place ? CL_MAP_READ : CL_MAP_WRITE, 0,
+        clause_size);
+  }
+  if (!in_place) copy(s.clauses.begin(), s.clauses.end(), bufs.clause);
+  if (bufs.var_cap < var_size) {
+    if (bufs.out) q.enqueueUnmapMemObject(bufs.out_buf, bufs.out);
+    bufs.out_buf =
+        cl::Buffer(context, CL_MEM_READ_WRITE, var_size, NULL, &err);
+    bufs.var_cap = var_size;
+    bufs.out = (signed char *)q.enqueueMapBuffer(
+        bufs.out_buf, CL_TRUE, CL_MAP_WRITE | CL_MAP_READ, 0, var_size);
+    // 2 * var_cnt + 2 ints
+    if (bufs.reason) q.enqueueUnmapMemObject(bufs.reason_buf, bufs.reason);
+    size_t reason_size = sizeof(int) * 2 * var_size;
+    bufs.reason_buf =
+        cl::Buffer(context, CL_MEM_WRITE_ONLY, reason_size, NULL, &err);
+    bufs.reason = (int *)q.enqueueMapBuffer(bufs.reason_buf, CL_TRUE,
+                                            CL_MAP_READ, 0, reason_size);
+  }
+
+  // ------------------------------------------------------------------------------------
+  // Step 3: Run the kernel
+  // ------------------------------------------------------------------------------------
+  // Set kernel arguments
+  krnl.setArg(0, bufs.clause_buf);
+  krnl.setArg(1, bufs.out_buf);
+  krnl.setArg(2, bufs.reason_buf);
+  krnl.setArg(3, s.var_cnt);
+  krnl.setArg(4, s.clause_cnt);
+
+  s.out = bufs.out;
+  s.clause = bufs.clause;
+  s.reason = bufs.reason;
+  s.krnl = &krnl;
+  s.q = &q;
+  s.out_buf = &bufs.out_buf;
+  s.clause_buf = &bufs.clause_buf;
+  s.reason_buf = &bufs.reason_buf;
+
+  Status result = s.solve();
+  if (bufs.host_ptr) {
+    // The cache mapping goes away with s, so must the buffer wrapping it
+    q.enqueueUnmapMemObject(bufs.clause_buf, bufs.clause);
+    q.finish();
+    bufs.clause_buf = cl::Buffer();
+    bufs.clause = nullptr;
+    bufs.host_ptr = false;
+  }
+  return result;
+}
+
+// --verify: the model printSol() prints checked against the formula as given,
+// the file or the job's text. False with error set if it doesn't satisfy it.
+static bool verifyModel(const SATInstance &s, const string &infile,
+                        const string *job, string &error) {
+  PackedModel model;
+  model.assign(s.vars.data(), s.var_cnt, s.var_order);
+  int threads = max(1u, thread::hardware_concurrency());
+  if (job) return checkModel(job->data(), job->size(), model, threads, error);
+  return checkModelFile(infile, model, threads, error);
+}
+
+static void usage() {
+  cerr << "Error: incorrect usage. Expected: ./a.out kernal_file filename.cnf "
+          "[--cache|--cache-revalidate] [--reorder] [--shards=k] [--hybrid] "
+          "[--verify]\n"
+          "   or: ./a.out kernal_file --batch=list.txt "
+          "[--cache|--cache-revalidate] [--reorder] [--hybrid] [--verify]\n"
+          "   or: ./a.out kernal_file --daemon=socket [--reorder] [--hybrid] "
+          "[--verify]"
+       << endl;
+  exit(0);
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    cerr << "Error: incorrect usage. Expected: ./a.out kernal_file filename.cnf"
-         << endl;
-    exit(0);
+  if (argc < 3) usage();
+  string infile, batch_file, socket_path;
+  bool use_cache = false, revalidate = false, reorder = false, verify = false,
+       hybrid = false;
+  int shard_cnt = 1;
+  for (int i = 2; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--cache")
+      use_cache = true;
+    else if (arg == "--cache-revalidate")
+      use_cache = revalidate = true;
+    else if (arg == "--reorder")
+      reorder = true;
+    else if (arg == "--verify")
+      verify = true;
+    else if (arg == "--hybrid")
+      hybrid = true;
+    else if (arg.rfind("--shards=", 0) == 0)
+      shard_cnt = atoi(arg.c_str() + strlen("--shards="));
+    else if (arg.rfind("--batch=", 0) == 0)
+      batch_file = arg.substr(strlen("--batch="));
+    else if (arg.rfind("--daemon=", 0) == 0)
+      socket_path = arg.substr(strlen("--daemon="));
+    else if (arg[0] != '-' && infile.empty())
+      infile = arg;
+    else
+      usage();
+  }
+  if (!infile.empty() + !batch_file.empty() + !socket_path.empty() != 1)
+    usage();
+  // Sharding is set up per instance, only for a single file
+  if (shard_cnt < 1 || (shard_cnt > 1 && infile.empty())) usage();
+
+  // Files listed one per line
+  vector<string> files;
+  if (!batch_file.empty()) {
+    ifstream fin(batch_file);
+    if (!fin.is_open()) {
+      cerr << "Error: couldn't open file " << batch_file << endl;
+      exit(0);
+    }
+    for (string line; getline(fin, line);)
+      if (!line.empty()) files.push_back(line);
   }
 
   SATInstance s;
-  s.read(argv[2]);
-  cerr << "Loaded SAT\n";
+  s.reorder = reorder;
+  s.use_hybrid = hybrid;
+  if (!infile.empty()) {
+    s.read(infile, use_cache, revalidate);
+    cerr << "Loaded SAT\n";
+  }
 
   // ------------------------------------------------------------------------------------
   // Step 1: Initialize the OpenCL environment
@@ -204,49 +562,98 @@ int main(int argc, char *argv[]) {
   cl::Program program(context, devices, bins, NULL, &err);
   cl::CommandQueue q(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
   cl::Kernel krnl(program, "kernal", &err);
+  DeviceBuffers bufs;
 
-  // ------------------------------------------------------------------------------------
-  // Step 2: Create buffers and initialize test values
-  // ------------------------------------------------------------------------------------
-  // Create the buffers and allocate memory
-  cl::Buffer clause_buf(context, CL_MEM_READ_ONLY,
-                        sizeof(int) * s.clauses.size(), NULL, &err);
-  cl::Buffer out_buf(context, CL_MEM_READ_WRITE,
-                     sizeof(int) * s.vars.size(), NULL, &err);
-
-  // Map buffers to kernel arguments, thereby assigning them to specific device
-  // memory banks
-  krnl.setArg(0, clause_buf);
-  krnl.setArg(1, out_buf);
-
-  // Map host-side buffer memory to user-space pointers
-  int *clause = (int *)q.enqueueMapBuffer(clause_buf, CL_TRUE, CL_MAP_READ, 0,
-                                          sizeof(int) * s.clauses.size());
-  int *out =
-      (int *)q.enqueueMapBuffer(out_buf, CL_TRUE, CL_MAP_WRITE | CL_MAP_READ, 0,
-                                sizeof(int) * s.vars.size());
-
-  // ------------------------------------------------------------------------------------
-  // Step 3: Run the kernel
-  // ------------------------------------------------------------------------------------
-  // Set kernel arguments
-  krnl.setArg(0, clause_buf);
-  krnl.setArg(1, out_buf);
-  krnl.setArg(2, s.var_cnt);
-  krnl.setArg(3, s.clause_cnt);
+  if (!socket_path.empty()) {
+    // fsatd mode: everything above is paid for once, see daemon.h for the
+    // protocol
+    serve(socket_path, [&](const string &job) {
+      ostringstream out;
+      auto start = chrono::steady_clock::now();
+      istringstream in(job);
+      SATInstance js;
+      js.reorder = reorder;
+      js.use_hybrid = hybrid;
+      string error;
+      if (!parseDIMACS(in, js.cnf, error) || !js.load(error)) {
+        out << "c error: " << error << "\n";
+        return out.str();
+      }
+      auto solve_start = chrono::steady_clock::now();
+      Status result = solveOnDevice(js, context, q, krnl, bufs);
+      if (result == Solved && verify && !verifyModel(js, "", &job, error)) {
+        out << "c error: model check failed, " << error << "\n";
+        return out.str();
+      }
+      if (result == Solved)
+        js.printSol(out);
+      else
+        out << "UNSATISFIABLE" << "\n";
+      auto end = chrono::steady_clock::now();
+      if (js.hybrid) js.hybrid->printStats(out);
+      out << "c parse time: "
+          << chrono::duration<double>(solve_start - start).count() << " s\n";
+      out << "c solve time: "
+          << chrono::duration<double>(end - solve_start).count() << " s\n";
+      return out.str();
+    });
+  }
 
-  s.out = out;
-  s.clause = clause;
-  s.krnl = &krnl;
-  s.q = &q;
-  s.out_buf = &out_buf;
-  s.clause_buf = &clause_buf;
+  if (!batch_file.empty()) {
+    // One device, so jobs run back to back, but none of them pays for the
+    // setup above again
+    auto start = chrono::steady_clock::now();
+    for (auto &file : files) {
+      auto job_start = chrono::steady_clock::now();
+      SATInstance job;
+      job.reorder = reorder;
+      job.use_hybrid = hybrid;
+      string error;
+      if (!(use_cache ? tryReadCached(file, job.cnf, error, revalidate)
+                      : tryReadDIMACS(file, job.cnf, error)) ||
+          !job.load(error)) {
+        cerr << "Warning: " << file << ": " << error << endl;
+        cout << file << " ERROR" << endl;
+        continue;
+      }
+      Status result = solveOnDevice(job, context, q, krnl, bufs);
+      if (result == Solved && verify &&
+          !verifyModel(job, file, nullptr, error)) {
+        cout << file << " ERROR" << endl;
+        continue;
+      }
+      cout << file << " " << (result == Solved ? "SAT" : "UNSAT") << " "
+           << chrono::duration<double>(chrono::steady_clock::now() -
+                                       job_start)
+                  .count()
+           << endl;
+      if (job.hybrid) job.hybrid->printStats(cerr);
+    }
+    double elapsed =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "c batch: " << files.size() << " instances, " << elapsed << " s, "
+         << (elapsed > 0 ? files.size() / elapsed : 0) << " instances/sec"
+         << endl;
+    return 0;
+  }
 
   cerr << "solving now\n";
 
-  if (s.solve() == Solved)
+  Status result;
+  if (shard_cnt > 1) {
+    s.setupShards(shard_cnt, context, device, program);
+    result = s.solve();
+  } else
+    result = solveOnDevice(s, context, q, krnl, bufs);
+  string error;
+  if (result == Solved && verify && !verifyModel(s, infile, nullptr, error)) {
+    cerr << "Error: model check failed, " << error << endl;
+    exit(1);
+  }
+  if (result == Solved)
     s.printSol();
   else
     cout << "UNSATISFIABLE" << endl;
+  if (s.hybrid) s.hybrid->printStats(cerr);
   return 0;
 }
@@ -1,12 +1,18 @@
 // clauses -> read only
-// out -> read/write
+// out -> read/write, a byte per variable: -1 (unassigned), 0 (false), 1 (true)
+// reasons -> write only, 2 * var_cnt + 2 ints: reasons[0] the index of a
+//            falsified clause (-1 if there is none), reasons[1] the number n
+//            of implications, then n pairs of implied literal and index of
+//            the clause that implied it, in implication order. Enough for the
+//            host to rebuild the implication graph without propagating.
 // var_cnt -> read_only
 // clause_cnt -> read_only
 // conflict -> write only
-void kernal(int *clauses, int *out, int var_cnt,
+void kernal(int *clauses, signed char *out, int *reasons, int var_cnt,
             int clause_cnt) {
 
   // Resolve implications.
+  int implied_cnt = 0;
   bool changed = true;
   while (changed) {
     changed = false;
@@ -39,6 +45,9 @@ void kernal(int *clauses, int *out, int var_cnt,
         // Implication yay.
         if (!other1 && !other2) {
           out[var[j]] = 1 ^ !sign[j];
+          reasons[2 + 2 * implied_cnt] = sign[j] ? var[j] : -var[j];
+          reasons[3 + 2 * implied_cnt] = i;
+          implied_cnt++;
           changed = true;
         };
       }
@@ -48,6 +57,8 @@ void kernal(int *clauses, int *out, int var_cnt,
     }
   }
 
+  reasons[1] = implied_cnt;
+
   // Check for conflicts.
   for (unsigned i = 0; i < clause_cnt; ++i) {
     // Get variables.
@@ -74,8 +85,10 @@ void kernal(int *clauses, int *out, int var_cnt,
     // Check conflict.
     if (!(v[0] || v[1] || v[2])) {
       out[0] = 1;
+      reasons[0] = i;
       return;
     }
   }
   out[0] = 0;
+  reasons[0] = -1;
 }
@@ -0,0 +1,195 @@
+#include <immintrin.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The -1 byte of out, read unsigned
+static const unsigned char UNASSIGNED = 0xff;
+
+enum SimdLevel {
+  Scalar,
+  AVX2,
+  AVX512,
+};
+
+static SimdLevel detectLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return AVX512;
+  if (__builtin_cpu_supports("avx2")) return AVX2;
+  return Scalar;
+}
+
+static SimdLevel level = detectLevel();
+
+// Evaluates clause i against the current assignment, assigning its last
+// literal if it has become unit. Returns false if it is falsified.
+static inline bool propagateClause(const int *clauses, int i,
+                                   unsigned char *vals, int *reasons,
+                                   bool &changed) {
+  int unassigned = 0, last = 0;
+  for (int j = 0; j < 3; j++) {
+    int lit = clauses[3 * i + j];
+    unsigned char v = vals[lit < 0 ? -lit : lit];
+    if (v == UNASSIGNED) {
+      unassigned++;
+      last = lit;
+    } else if (v == (lit > 0))
+      return true;
+  }
+  if (unassigned == 0) {
+    reasons[0] = i;
+    return false;
+  }
+  if (unassigned == 1) {
+    vals[last < 0 ? -last : last] = last > 0;
+    reasons[2 + 2 * reasons[1]] = last;
+    reasons[3 + 2 * reasons[1]] = i;
+    reasons[1]++;
+    changed = true;
+  }
+  return true;
+}
+
+// One pass over clauses [begin, clause_cnt), false on conflict
+static bool sweepScalar(const int *clauses, int begin, int clause_cnt,
+                        unsigned char *vals, int *reasons, bool &changed) {
+  for (int i = begin; i < clause_cnt; i++)
+    if (!propagateClause(clauses, i, vals, reasons, changed)) return false;
+  return true;
+}
+
+// Evaluates 8 clauses at a time against the assignment as it was at the start
+// of the block, giving masks of unit and falsified clauses. Falsified stays
+// falsified as variables only get assigned, unit clauses are re-evaluated one
+// by one as earlier ones in the block may have settled them already.
+__attribute__((target("avx2"))) static bool sweepAVX2(const int *clauses,
+                                                      int clause_cnt,
+                                                      unsigned char *vals,
+                                                      int *reasons,
+                                                      bool &changed) {
+  const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  const __m256i low_byte = _mm256_set1_epi32(0xff);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i unassigned = _mm256_set1_epi32(UNASSIGNED);
+  int i = 0;
+  for (; i + 8 <= clause_cnt; i += 8) {
+    const int *block = clauses + 3 * i;
+    __m256i sat = zero, unassigned_cnt = zero;
+    for (int j = 0; j < 3; j++) {
+      __m256i lit = _mm256_i32gather_epi32(block + j, stride, 4);
+      __m256i var = _mm256_abs_epi32(lit);
+      // 4 byte gather at byte granularity, keep the low one
+      __m256i v = _mm256_and_si256(
+          _mm256_i32gather_epi32((const int *)vals, var, 1), low_byte);
+      __m256i want = _mm256_srli_epi32(_mm256_cmpgt_epi32(lit, zero), 31);
+      sat = _mm256_or_si256(sat, _mm256_cmpeq_epi32(v, want));
+      unassigned_cnt = _mm256_sub_epi32(unassigned_cnt,
+                                        _mm256_cmpeq_epi32(v, unassigned));
+    }
+    unsigned open = ~_mm256_movemask_ps(_mm256_castsi256_ps(sat)) & 0xff;
+    unsigned none = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(unassigned_cnt, zero)));
+    unsigned single = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(unassigned_cnt, one)));
+    if (open & none) {
+      reasons[0] = i + __builtin_ctz(open & none);
+      return false;
+    }
+    for (unsigned unit = open & single; unit; unit &= unit - 1)
+      if (!propagateClause(clauses, i + __builtin_ctz(unit), vals, reasons,
+                           changed))
+        return false;
+  }
+  return sweepScalar(clauses, i, clause_cnt, vals, reasons, changed);
+}
+
+// Same as sweepAVX2() with 16 clauses at a time and k-masks
+__attribute__((target("avx512f"))) static bool sweepAVX512(
+    const int *clauses, int clause_cnt, unsigned char *vals, int *reasons,
+    bool &changed) {
+  const __m512i stride = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27,
+                                           30, 33, 36, 39, 42, 45);
+  const __m512i low_byte = _mm512_set1_epi32(0xff);
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i unassigned = _mm512_set1_epi32(UNASSIGNED);
+  int i = 0;
+  for (; i + 16 <= clause_cnt; i += 16) {
+    const int *block = clauses + 3 * i;
+    __mmask16 sat = 0;
+    __m512i unassigned_cnt = zero;
+    for (int j = 0; j < 3; j++) {
+      __m512i lit = _mm512_i32gather_epi32(stride, block + j, 4);
+      __m512i var = _mm512_abs_epi32(lit);
+      __m512i v = _mm512_and_si512(
+          _mm512_i32gather_epi32(var, (const int *)vals, 1), low_byte);
+      __mmask16 pos = _mm512_cmpgt_epi32_mask(lit, zero);
+      sat |= _mm512_mask_cmpeq_epi32_mask(pos, v, one) |
+             _mm512_mask_cmpeq_epi32_mask(~pos, v, zero);
+      unassigned_cnt = _mm512_mask_add_epi32(
+          unassigned_cnt, _mm512_cmpeq_epi32_mask(v, unassigned),
+          unassigned_cnt, one);
+    }
+    unsigned open = ~sat & 0xffff;
+    unsigned none = _mm512_cmpeq_epi32_mask(unassigned_cnt, zero);
+    unsigned single = _mm512_cmpeq_epi32_mask(unassigned_cnt, one);
+    if (open & none) {
+      reasons[0] = i + __builtin_ctz(open & none);
+      return false;
+    }
+    for (unsigned unit = open & single; unit; unit &= unit - 1)
+      if (!propagateClause(clauses, i + __builtin_ctz(unit), vals, reasons,
+                           changed))
+        return false;
+  }
+  return sweepScalar(clauses, i, clause_cnt, vals, reasons, changed);
+}
+
+// Picks the implementation used by kernal_simd(), "scalar", "avx2" or
+// "avx512". Returns false if the name is unknown or the CPU lacks it.
+bool setSimdLevel(string name) {
+  SimdLevel best = detectLevel();
+  if (name == "scalar")
+    level = Scalar;
+  else if (name == "avx2" && best >= AVX2)
+    level = AVX2;
+  else if (name == "avx512" && best >= AVX512)
+    level = AVX512;
+  else
+    return false;
+  return true;
+}
+
+string simdLevel() {
+  return level == AVX512 ? "avx512" : level == AVX2 ? "avx2" : "scalar";
+}
+
+// Same contract as kernal(), vectorized for the CPU build: 8 (AVX2) or 16
+// (AVX-512) clauses are evaluated per step against a copy of out.
+void kernal_simd(const int *clauses, signed char *out, int *reasons,
+                 int var_cnt, int clause_cnt) {
+  // Reused across calls, +3 as the gathers read 4 bytes at every index
+  static thread_local vector<unsigned char> vals;
+  vals.resize(var_cnt + 4);
+  memcpy(vals.data(), out, var_cnt + 1);
+  reasons[0] = -1;
+  reasons[1] = 0;
+
+  bool ok = true, changed = true;
+  while (ok && changed) {
+    changed = false;
+    if (level == AVX512)
+      ok = sweepAVX512(clauses, clause_cnt, vals.data(), reasons, changed);
+    else if (level == AVX2)
+      ok = sweepAVX2(clauses, clause_cnt, vals.data(), reasons, changed);
+    else
+      ok = sweepScalar(clauses, 0, clause_cnt, vals.data(), reasons, changed);
+  }
+
+  memcpy(out + 1, vals.data() + 1, var_cnt);
+  out[0] = !ok;
+}
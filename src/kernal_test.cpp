@@ -1,32 +1,193 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "check.h"
+#include "cnf.h"
+#include "scheduler.h"
+#include "trace.h"
+
 using namespace std;
 
-void kernal(int *clauses, int *out, int var_cnt,
+// Variables probed per lookahead decision
+#define LOOKAHEAD_CANDIDATES 16
+
+void kernal(int *clauses, signed char *out, int *reasons, int var_cnt,
             int clause_cnt);
+extern "C" void kernal_tiled(const int *clauses, signed char *out,
+                             int *reasons, int var_cnt, int clause_cnt);
+void kernal_simd(const int *clauses, signed char *out, int *reasons,
+                 int var_cnt, int clause_cnt);
+void naiveScan(const int *clauses, signed char *out, int *reasons,
+               int var_cnt, int clause_cnt);
+bool setSimdLevel(string name);
+string simdLevel();
+
+enum Kernal {
+  Original,
+  Tiled,
+  Simd,
+  // Tiled/Simd and Original on every node, aborting if they disagree
+  CheckTiled,
+  CheckSimd,
+};
 
 enum Status {
   Solved,
   Unsolvable,
 };
 
+// Runs work(0..n-1) on n threads (the caller being one of them) every time
+// run() is called, standing in for n compute units launched together.
+class ShardPool {
+ public:
+  ShardPool(int n, function<void(int)> work);
+  ~ShardPool();
+  void run();
+
+ private:
+  int n;
+  function<void(int)> work;
+  vector<thread> threads;
+  mutex m;
+  condition_variable cv;
+  long long generation = 0;
+  int pending = 0;
+  bool done = false;
+};
+
+ShardPool::ShardPool(int n, function<void(int)> work) : n(n), work(work) {
+  for (int k = 1; k < n; k++)
+    threads.emplace_back([this, k] {
+      long long seen = 0;
+      while (true) {
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [&] { return generation != seen || done; });
+          if (done) return;
+          seen = generation;
+        }
+        this->work(k);
+        lock_guard<mutex> lock(m);
+        if (--pending == 0) cv.notify_all();
+      }
+    });
+}
+
+ShardPool::~ShardPool() {
+  {
+    lock_guard<mutex> lock(m);
+    done = true;
+  }
+  cv.notify_all();
+  for (auto &t : threads) t.join();
+}
+
+void ShardPool::run() {
+  {
+    lock_guard<mutex> lock(m);
+    pending = n - 1;
+    generation++;
+  }
+  cv.notify_all();
+  work(0);
+  unique_lock<mutex> lock(m);
+  cv.wait(lock, [this] { return pending == 0; });
+}
+
 class SATInstance {
  public:
   int var_cnt = 0, clause_cnt = 0;
-  // -1 (unassigned), 0 (false), 1 (true)
-  vector<int> vars = {};
+  // -1 (unassigned), 0 (false), 1 (true), a byte each as in the kernels
+  vector<signed char> vars = {};
   vector<int> clauses = {};
+  // The kernel's conflict clause and implications with their clauses, laid
+  // out as described in kernal.cpp
+  vector<int> reasons = {};
+  // Assigned variables in assignment order, so a backtrack only resets
+  // what it assigned instead of keeping a copy of vars per search node.
+  // Sized once when the instance is read.
+  vector<int> trail = {};
+  Kernal which = Original;
+  vector<signed char> check_vars = {};
+  vector<int> check_reasons = {};
+
+  // --check-reasons: every call's reasons are replayed on the assignment it
+  // was given and the result compared against naiveScan()
+  bool verify_reasons = false;
+  vector<signed char> given_vars = {}, ref_vars = {};
+  vector<int> ref_reasons = {};
+
+  // Clause sharding: shard k owns clauses [shard_begin[k], shard_begin[k + 1])
+  // and propagates them against its own copy of vars in shard_vars[k]
+  int shard_cnt = 1;
+  vector<int> shard_begin = {};
+  vector<vector<signed char>> shard_vars = {};
+  vector<vector<int>> shard_reasons = {};
+  ShardPool *pool = nullptr;
+  long long shard_rounds = 0;
+
+  // Original number of each variable if --reorder renumbered them, empty
+  // otherwise
+  bool reorder = false;
+  vector<int> var_order = {};
 
-  void read(string infile);
+  // --record: every assignment handed to runKernal(), for propbench
+  TraceWriter *trace = nullptr;
+
+  // --lookahead: decisions go to the best of LOOKAHEAD_CANDIDATES
+  // preselected variables, each propagated with both values. The probes are
+  // independent, so they run as one batch across look_pool's threads, thread
+  // k propagating into probe_vars[k] and probe_reasons[k].
+  ShardPool *look_pool = nullptr;
+  int look_threads = 0;
+  // Clauses by literal, 2 * var + (literal < 0)
+  vector<int> occ_begin = {}, occ = {};
+  vector<int> look_weight = {}, candidates = {}, probe_lits = {};
+  vector<long long> probe_scores = {};
+  vector<vector<signed char>> probe_vars = {};
+  vector<vector<int>> probe_reasons = {};
+  atomic<int> next_probe{0};
+  long long look_rounds = 0, probe_cnt = 0, failed_cnt = 0;
+
+  // --hybrid: each call goes to whichever of the CPU and the device hybrid
+  // predicts to be faster. The CPU runs kernal() on the active clauses, as
+  // host_with_kernal does. The device is a stand-in, the selected kernel on
+  // all of them followed by device_latency ns for launch and transfer.
+  HybridScheduler *hybrid = nullptr;
+  double device_latency = 0;
+  // Decisions on the current path
+  int depth = 0;
+  vector<int> active_lits = {}, active_index = {};
+
+  void callKernal(const int *cls, int cnt, signed char *out, int *r);
+  void runKernal();
+  void runHybrid();
+  void runUnsharded();
+  void verifyReasons();
+  void setupShards(int k);
+  void runShard(int k);
+  void runSharded();
+  void read(string infile, bool use_cache = false, bool revalidate = false);
   Status solve();
   Status backtrack();
+  void recordAssigned();
+  void undo(unsigned mark);
   vector<int> resolveImplications();
   int getImpliedVar();
   bool conflictExists();
   int selectVar();
+  void setupLookahead(int threads);
+  int lookahead();
+  void runProbes(int k);
   void printSol();
   void printClauses();
 };
@@ -35,71 +196,301 @@ static int mod(int x) {
   return x < 0? -x : x;
 }
 
-void SATInstance::read(string infile) {
-  ifstream fin(infile);
-  if (!fin.is_open()) {
-    cerr << "Error: couldn't open file " << infile << endl;
-    exit(0);
-  }
-  char c;  // check if line is comment
-  string s;
-  while (true) {
-    fin >> c;
-    if (c == 'c')
-      getline(fin, s);
-    else
-      break;
-  }
-  fin >> s;
-  if (s != "cnf") {
-    cerr << "Error: expected cnf input file, given " << s << endl;
-    exit(1);
-  }
-  fin >> var_cnt >> clause_cnt;
+void SATInstance::read(string infile, bool use_cache, bool revalidate) {
+  CNF cnf;
+  if (use_cache)
+    readCached(infile, cnf, revalidate);
+  else
+    readDIMACS(infile, cnf);
+  var_order.clear();
+  if (reorder) reorderCNF(cnf, var_order);
+  var_cnt = cnf.var_cnt;
+  clause_cnt = cnf.clause_cnt;
   vars.clear();
   vars.resize(var_cnt + 1);
-  clauses.clear();
-  int var;
-  for (int i = 0; i < clause_cnt; i++)
-    for (fin >> var; var != 0; fin >> var) clauses.push_back(var);
+  string error;
+  if (!kernelClauses(cnf, clauses, error)) {
+    cerr << "Error: " << error << endl;
+    exit(1);
+  }
+  reasons.assign(2 * var_cnt + 2, 0);
+  trail.clear();
+  trail.reserve(var_cnt);
 }
 
 Status SATInstance::solve() {
   for (int i = 1; i <= var_cnt; i++) vars[i] = -1;
+  undo(0);
   return backtrack();
 }
 
 Status SATInstance::backtrack() {
-  vector<int> curr = vars;
-  kernal(clauses.data(), vars.data(), var_cnt, clause_cnt);
+  unsigned mark = trail.size();
+  if (trace) trace->add(vars.data());
+  runKernal();
+  recordAssigned();
   if (vars[0]) {
     // Current (partial) assignment causes conflict, undo implications and
     // backtrack
-    vars = curr;
+    undo(mark);
     return Unsolvable;
   }
-  int var = selectVar();
+  int var, value = 0;
+  if (look_pool) {
+    int lit = lookahead();
+    if (vars[0]) {
+      // Both values of a candidate failed
+      undo(mark);
+      return Unsolvable;
+    }
+    var = lit == 0 ? var_cnt + 1 : mod(lit);
+    value = lit > 0;
+  } else
+    var = selectVar();
   if (var == var_cnt + 1)
     return Solved;  // All variables are assigned with no conflict, we are done
-  // Try to recurse by assigning current var false
-  vars[var] = 0;
+  // Try to recurse by assigning current var its first value, false unless
+  // the lookahead says otherwise
+  vars[var] = value;
+  trail.push_back(var);
+  depth++;
   Status s = backtrack();
   if (s == Solved)
-    return Solved;  // Yay! False for current var worked!
+    return Solved;  // Yay! The first value for current var worked!
   else {
-    // False didn't work, try if true works
-    vars[var] = 1;
+    // That didn't work, try if the other one works
+    vars[var] = !value;
     s = backtrack();
     if (s == Solved)
-      return Solved;  // Yay! True for current var worked!
+      return Solved;  // Yay! The other value for current var worked!
     else {
       // Both didn't work, backtrack by leaving current var unassigned
-      vars = curr;
+      depth--;
+      undo(mark);
       return Unsolvable;
     }
   }
 }
 
+// The kernel lists what it implied in order, so that goes on the trail as
+// is. Decisions are put there by backtrack().
+void SATInstance::recordAssigned() {
+  for (int i = 0; i < reasons[1]; i++)
+    trail.push_back(mod(reasons[2 + 2 * i]));
+}
+
+// Unassigns everything put on the trail after mark
+void SATInstance::undo(unsigned mark) {
+  while (trail.size() > mark) {
+    vars[trail.back()] = -1;
+    trail.pop_back();
+  }
+  vars[0] = 0;
+}
+
+void SATInstance::runKernal() {
+  if (verify_reasons) given_vars = vars;
+  if (hybrid)
+    runHybrid();
+  else if (shard_cnt > 1)
+    runSharded();
+  else
+    runUnsharded();
+  if (verify_reasons) verifyReasons();
+}
+
+void SATInstance::runHybrid() {
+  Backend b = hybrid->route(depth);
+  auto start = chrono::steady_clock::now();
+  int active = -1;
+  if (b == Cpu) {
+    active = propagateActive(
+        [this](const int *cls, int cnt, signed char *out, int *r) {
+          kernal((int *)cls, out, r, var_cnt, cnt);
+        },
+        clauses.data(), clause_cnt, vars.data(), reasons.data(), active_lits,
+        active_index);
+  } else {
+    if (shard_cnt > 1)
+      runSharded();
+    else
+      runUnsharded();
+    // Spin, a sleep is far coarser than the latencies of interest
+    auto until = chrono::steady_clock::now() +
+                 chrono::nanoseconds((long long)device_latency);
+    while (chrono::steady_clock::now() < until)
+      ;
+  }
+  hybrid->record(
+      b, depth,
+      chrono::duration<double, nano>(chrono::steady_clock::now() - start)
+          .count(),
+      active);
+}
+
+void SATInstance::runUnsharded() {
+  if (which == Original) {
+    kernal(clauses.data(), vars.data(), reasons.data(), var_cnt, clause_cnt);
+    return;
+  }
+  bool check = which == CheckTiled || which == CheckSimd;
+  if (check) check_vars = vars;
+  if (which == Simd || which == CheckSimd)
+    kernal_simd(clauses.data(), vars.data(), reasons.data(), var_cnt,
+                clause_cnt);
+  else
+    kernal_tiled(clauses.data(), vars.data(), reasons.data(), var_cnt,
+                 clause_cnt);
+  if (vars[0] == -1) {
+    cerr << "Error: too many variables for kernal_tiled" << endl;
+    exit(1);
+  }
+  if (!check) return;
+  check_reasons.resize(reasons.size());
+  kernal(clauses.data(), check_vars.data(), check_reasons.data(), var_cnt,
+         clause_cnt);
+  // On conflict the two stop at different points, only the flag has to
+  // agree
+  if (vars[0] != check_vars[0] || (!vars[0] && vars != check_vars)) {
+    cerr << "Error: "
+         << (which == CheckSimd ? "kernal_simd" : "kernal_tiled")
+         << " disagrees with kernal" << endl;
+    exit(1);
+  }
+}
+
+// Each implication has to come from a clause whose other literals are false
+// at that point and together they have to account for every variable the
+// kernel assigned, a conflict clause has to be falsified. The conflict flag
+// and, without a conflict, the assignment have to match naiveScan(), which
+// finds the same implications as kernal() so its reasons have to match too.
+void SATInstance::verifyReasons() {
+  ref_vars = given_vars;
+  ref_reasons.resize(reasons.size());
+  naiveScan(clauses.data(), ref_vars.data(), ref_reasons.data(), var_cnt,
+            clause_cnt);
+
+  vector<signed char> &cur = given_vars;
+  auto litFalse = [&](int lit) { return cur[mod(lit)] == (lit < 0); };
+  const char *error = nullptr;
+  int n = reasons[1];
+  if (n < 0 || n > var_cnt) error = "have a bad implication count";
+  for (int i = 0; i < n && !error; i++) {
+    int lit = reasons[2 + 2 * i], c = reasons[3 + 2 * i];
+    if (lit == 0 || mod(lit) > var_cnt || cur[mod(lit)] != -1)
+      error = "imply a variable that is assigned";
+    else if (c < 0 || c >= clause_cnt)
+      error = "have a clause out of range";
+    if (error) break;
+    bool in_clause = false, unit = true;
+    for (int j = 0; j < 3; j++) {
+      int other = clauses[3 * c + j];
+      if (other == lit)
+        in_clause = true;
+      else
+        unit &= litFalse(other);
+    }
+    if (!in_clause || !unit) error = "have a clause that is not unit";
+    cur[mod(lit)] = lit > 0;
+  }
+  int c = reasons[0];
+  if (error)
+    ;
+  else if (!equal(cur.begin() + 1, cur.end(), vars.begin() + 1))
+    error = "don't account for the assignment";
+  else if ((c >= 0) != (vars[0] == 1) || c >= clause_cnt)
+    error = "disagree with the conflict flag";
+  else if (c >= 0 && !(litFalse(clauses[3 * c]) &&
+                       litFalse(clauses[3 * c + 1]) &&
+                       litFalse(clauses[3 * c + 2])))
+    error = "have a conflict clause that is not falsified";
+  else if (vars[0] != ref_vars[0] || (!vars[0] && vars != ref_vars))
+    error = "disagree with naiveScan";
+  else if (which == Original && shard_cnt == 1 &&
+           !equal(reasons.begin(), reasons.begin() + 2 + 2 * n,
+                  ref_reasons.begin()))
+    error = "differ from naiveScan's";
+  if (error) {
+    cerr << "Error: the reasons from "
+         << (which == Original                       ? "kernal "
+             : which == Tiled || which == CheckTiled ? "kernal_tiled "
+                                                     : "kernal_simd ")
+         << error << endl;
+    exit(1);
+  }
+}
+
+void SATInstance::setupShards(int k) {
+  shard_cnt = max(1, min(k, clause_cnt));
+  shard_begin.resize(shard_cnt + 1);
+  for (int i = 0; i <= shard_cnt; i++)
+    shard_begin[i] = (long long)clause_cnt * i / shard_cnt;
+  shard_vars.assign(shard_cnt, vector<signed char>(var_cnt + 1));
+  shard_reasons.assign(shard_cnt, vector<int>(2 * var_cnt + 2));
+  delete pool;
+  pool = new ShardPool(shard_cnt, [this](int k) { runShard(k); });
+}
+
+// The selected kernel on clauses cls[0..cnt), without the check modes'
+// cross-checking
+void SATInstance::callKernal(const int *cls, int cnt, signed char *out,
+                             int *r) {
+  if (which == Tiled || which == CheckTiled)
+    kernal_tiled(cls, out, r, var_cnt, cnt);
+  else if (which == Simd || which == CheckSimd)
+    kernal_simd(cls, out, r, var_cnt, cnt);
+  else
+    kernal((int *)cls, out, r, var_cnt, cnt);
+}
+
+void SATInstance::runShard(int k) {
+  vector<signed char> &out = shard_vars[k];
+  copy(vars.begin(), vars.end(), out.begin());
+  int *shard = clauses.data() + 3 * shard_begin[k];
+  int cnt = shard_begin[k + 1] - shard_begin[k];
+  callKernal(shard, cnt, out.data(), shard_reasons[k].data());
+}
+
+// Every shard propagates to its own fixpoint, then the implications are
+// merged into vars by replaying each shard's reasons, with the clause
+// indices made global again. An implication from one shard can trigger more
+// in another, so this repeats until a round adds nothing. The last round has
+// every shard check its clauses against the final assignment, so a conflict
+// anywhere is caught.
+void SATInstance::runSharded() {
+  bool changed = true;
+  int conflict = -1, implied_cnt = 0;
+  while (changed && conflict < 0) {
+    changed = false;
+    pool->run();
+    shard_rounds++;
+    for (int k = 0; k < shard_cnt && conflict < 0; k++) {
+      if (shard_vars[k][0] == -1) {
+        cerr << "Error: too many variables for kernal_tiled" << endl;
+        exit(1);
+      }
+      const int *r = shard_reasons[k].data();
+      for (int i = 0; i < r[1] && conflict < 0; i++) {
+        int lit = r[2 + 2 * i], var = mod(lit);
+        int clause = shard_begin[k] + r[3 + 2 * i];
+        if (vars[var] == -1) {
+          vars[var] = lit > 0;
+          reasons[2 + 2 * implied_cnt] = lit;
+          reasons[3 + 2 * implied_cnt] = clause;
+          implied_cnt++;
+          changed = true;
+        } else if (vars[var] != (lit > 0))
+          conflict = clause;  // Two shards implied opposite values
+      }
+      // Falsified on the shard's assignment, all of which is in vars now
+      if (conflict < 0 && r[0] >= 0) conflict = shard_begin[k] + r[0];
+    }
+  }
+  vars[0] = conflict >= 0;
+  reasons[0] = conflict;
+  reasons[1] = implied_cnt;
+}
+
 // Select next variable to try, insert any heuristics if desired
 int SATInstance::selectVar() {
   for (int i = 1; i <= var_cnt; i++)
@@ -107,24 +498,274 @@ int SATInstance::selectVar() {
   return var_cnt + 1;
 }
 
+// Whether literal j of a kernel clause also appears before it, as the
+// padding of a clause shorter than 3 does. Lookahead counts each literal of
+// a clause once, so padded clauses don't weigh more than the others.
+static bool repeated(const int *cl, int j) {
+  for (int k = 0; k < j; k++)
+    if (cl[k] == cl[j]) return true;
+  return false;
+}
+
+void SATInstance::setupLookahead(int threads) {
+  look_threads = threads;
+  occ_begin.assign(2 * var_cnt + 3, 0);
+  for (int i = 0; i < (int)clauses.size(); i++)
+    if (!repeated(&clauses[i - i % 3], i % 3))
+      occ_begin[2 * mod(clauses[i]) + (clauses[i] < 0) + 1]++;
+  for (int i = 1; i < (int)occ_begin.size(); i++)
+    occ_begin[i] += occ_begin[i - 1];
+  occ.resize(occ_begin.back());
+  vector<int> fill(occ_begin.begin(), occ_begin.end() - 1);
+  for (int i = 0; i < (int)clauses.size(); i++)
+    if (!repeated(&clauses[i - i % 3], i % 3))
+      occ[fill[2 * mod(clauses[i]) + (clauses[i] < 0)]++] = i / 3;
+  look_weight.assign(var_cnt + 1, 0);
+  probe_vars.assign(threads, vector<signed char>(var_cnt + 1));
+  probe_reasons.assign(threads, vector<int>(2 * var_cnt + 2));
+  delete look_pool;
+  look_pool = new ShardPool(threads, [this](int k) { runProbes(k); });
+}
+
+// Propagates probe_lits[i] on top of vars for every i handed out by
+// next_probe. The score is the number of clauses the probe reduced, ones
+// that lost a literal without being satisfied, or -1 if it failed.
+void SATInstance::runProbes(int k) {
+  signed char *out = probe_vars[k].data();
+  int *r = probe_reasons[k].data();
+  for (int i = next_probe++; i < (int)probe_lits.size(); i = next_probe++) {
+    int lit = probe_lits[i];
+    copy(vars.begin(), vars.end(), out);
+    out[mod(lit)] = lit > 0;
+    callKernal(clauses.data(), clause_cnt, out, r);
+    long long score = -1;
+    if (!out[0]) {
+      score = 0;
+      // The probe itself, then what it implied
+      for (int j = -1; j < r[1]; j++) {
+        int assigned = j < 0 ? lit : r[2 + 2 * j];
+        int falsified = 2 * mod(assigned) + (assigned > 0);
+        for (int p = occ_begin[falsified]; p < occ_begin[falsified + 1];
+             p++) {
+          const int *c = clauses.data() + 3 * occ[p];
+          bool sat = false;
+          for (int m = 0; m < 3; m++)
+            sat |= out[mod(c[m])] == (c[m] > 0);
+          score += !sat;
+        }
+      }
+    }
+    probe_scores[i] = score;
+  }
+}
+
+// march-style lookahead. Preselects the free variables occurring most in
+// clauses that are not satisfied yet, a reduced clause counting double as
+// its variables are the likeliest to propagate, and probes both values of
+// each. A value that fails fixes the variable to the other one, after which
+// the round is repeated on the new assignment. Returns the literal to branch
+// on, which is the candidate maximizing the product of its two scores, with
+// the value that reduced fewer clauses (so is the less constrained one)
+// first. Returns 0 once everything is assigned, with vars[0] set if both
+// values of some variable failed.
+int SATInstance::lookahead() {
+  while (true) {
+    look_rounds++;
+    fill(look_weight.begin(), look_weight.end(), 0);
+    for (int c = 0; c < clause_cnt; c++) {
+      const int *cl = clauses.data() + 3 * c;
+      bool sat = false;
+      int free_cnt = 0;
+      for (int j = 0; j < 3; j++) {
+        sat |= vars[mod(cl[j])] == (cl[j] > 0);
+        free_cnt += vars[mod(cl[j])] == -1 && !repeated(cl, j);
+      }
+      if (sat) continue;
+      for (int j = 0; j < 3; j++)
+        if (vars[mod(cl[j])] == -1 && !repeated(cl, j))
+          look_weight[mod(cl[j])] += 4 - free_cnt;
+    }
+    candidates.clear();
+    for (int v = 1; v <= var_cnt; v++)
+      if (vars[v] == -1 && look_weight[v] > 0) candidates.push_back(v);
+    if (candidates.empty()) {
+      // Every clause is satisfied, whatever is still free can be anything
+      int v = selectVar();
+      return v == var_cnt + 1 ? 0 : -v;
+    }
+    int cand_cnt = min<int>(candidates.size(), LOOKAHEAD_CANDIDATES);
+    partial_sort(candidates.begin(), candidates.begin() + cand_cnt,
+                 candidates.end(), [&](int a, int b) {
+                   return look_weight[a] > look_weight[b] ||
+                          (look_weight[a] == look_weight[b] && a < b);
+                 });
+    candidates.resize(cand_cnt);
+
+    probe_lits.clear();
+    for (int v : candidates) {
+      probe_lits.push_back(-v);
+      probe_lits.push_back(v);
+    }
+    probe_scores.assign(probe_lits.size(), 0);
+    next_probe = 0;
+    look_pool->run();
+    probe_cnt += probe_lits.size();
+
+    bool fixed = false;
+    int best = 0;
+    long long best_score = -1;
+    for (int i = 0; i < cand_cnt; i++) {
+      int v = candidates[i];
+      long long neg = probe_scores[2 * i], pos = probe_scores[2 * i + 1];
+      if (neg < 0 && pos < 0) {
+        vars[0] = 1;
+        return 0;
+      }
+      if (neg < 0 || pos < 0) {
+        // Failed literal, the other value is implied by what is assigned
+        vars[v] = neg < 0;
+        trail.push_back(v);
+        failed_cnt++;
+        fixed = true;
+        continue;
+      }
+      long long score = neg * pos * 1024 + neg + pos;
+      if (score > best_score) {
+        best_score = score;
+        best = pos < neg ? v : -v;
+      }
+    }
+    if (!fixed) return best;
+    runKernal();
+    recordAssigned();
+    if (vars[0]) return 0;
+  }
+}
+
 void SATInstance::printSol() {
   cout << "s SATISFIABLE" << endl;
   cout << "v ";
-  for (int i = 1; i <= var_cnt; i++) cout << (vars[i] ? i : -i) << " ";
+  // Back in input numbering
+  vector<signed char> model = vars;
+  for (int i = 1; i <= var_cnt && !var_order.empty(); i++)
+    model[var_order[i]] = vars[i];
+  for (int i = 1; i <= var_cnt; i++) cout << (model[i] ? i : -i) << " ";
   cout << endl;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    cerr << "Error: incorrect usage. Expected: ./a.out filename.cnf" << endl;
+  bool use_cache = false, revalidate = false, reorder = false,
+       check_reasons = false, verify = false;
+  Kernal which = Original;
+  int shard_cnt = 1, look_threads = 0;
+  double hybrid_latency = -1;
+  string trace_file;
+  for (int i = 1; i < argc - 1; i++) {
+    string arg = argv[i];
+    if (arg == "--cache")
+      use_cache = true;
+    else if (arg == "--cache-revalidate")
+      use_cache = revalidate = true;
+    else if (arg == "--reorder")
+      reorder = true;
+    else if (arg == "--tiled")
+      which = Tiled;
+    else if (arg == "--check-tiled")
+      which = CheckTiled;
+    else if (arg == "--simd")
+      which = Simd;
+    else if (arg.rfind("--simd=", 0) == 0) {
+      which = Simd;
+      if (!setSimdLevel(arg.substr(strlen("--simd=")))) {
+        cerr << "Error: " << arg << " is not supported on this CPU" << endl;
+        exit(1);
+      }
+    } else if (arg == "--check-simd")
+      which = CheckSimd;
+    else if (arg == "--check-reasons")
+      check_reasons = true;
+    else if (arg == "--verify")
+      verify = true;
+    else if (arg == "--hybrid")
+      hybrid_latency = 100;
+    else if (arg.rfind("--hybrid=", 0) == 0) {
+      hybrid_latency = atof(arg.c_str() + strlen("--hybrid="));
+      if (hybrid_latency < 0) argc = 0;
+    }
+    else if (arg == "--lookahead")
+      look_threads = max(1u, thread::hardware_concurrency());
+    else if (arg.rfind("--lookahead=", 0) == 0) {
+      look_threads = atoi(arg.c_str() + strlen("--lookahead="));
+      if (look_threads < 1) argc = 0;
+    } else if (arg.rfind("--record=", 0) == 0)
+      trace_file = arg.substr(strlen("--record="));
+    else if (arg.rfind("--shards=", 0) == 0)
+      shard_cnt = atoi(arg.c_str() + strlen("--shards="));
+    else
+      argc = 0;
+  }
+  bool check = which == CheckTiled || which == CheckSimd;
+  if (argc < 2 || shard_cnt < 1 || (shard_cnt > 1 && check)) {
+    cerr << "Error: incorrect usage. Expected: ./a.out "
+            "[--cache|--cache-revalidate] [--reorder] "
+            "[--tiled|--check-tiled|--simd[=scalar|avx2|avx512]|--check-simd] "
+            "[--check-reasons] [--shards=k] [--lookahead[=threads]] "
+            "[--hybrid[=latency_us]] [--record=trace] [--verify] filename.cnf"
+         << endl;
     exit(0);
   }
 
   SATInstance s;
-  s.read(argv[1]);
-  if (s.solve() == Solved)
+  s.reorder = reorder;
+  s.read(argv[argc - 1], use_cache, revalidate);
+  s.which = which;
+  s.verify_reasons = check_reasons;
+  if (shard_cnt > 1) s.setupShards(shard_cnt);
+  if (look_threads > 0) s.setupLookahead(look_threads);
+  if (hybrid_latency >= 0) {
+    s.hybrid = new HybridScheduler(s.var_cnt, s.clause_cnt);
+    s.device_latency = hybrid_latency * 1000;
+  }
+  if (!trace_file.empty())
+    s.trace = new TraceWriter(trace_file, s.clauses, s.var_cnt, reorder);
+  auto start = chrono::steady_clock::now();
+  Status result = s.solve();
+  double solve_time =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (result == Solved && verify) {
+    PackedModel model;
+    model.assign(s.vars.data(), s.var_cnt, s.var_order);
+    string error;
+    if (!checkModelFile(argv[argc - 1], model,
+                        max(1u, thread::hardware_concurrency()), error)) {
+      cerr << "Error: model check failed, " << error << endl;
+      exit(1);
+    }
+  }
+  if (result == Solved)
     s.printSol();
   else
     cout << "UNSATISFIABLE" << endl;
+  if (which == Simd || which == CheckSimd)
+    cerr << "c simd: " << simdLevel() << endl;
+  if (s.pool) {
+    cerr << "c shards: " << s.shard_cnt << ", rounds: " << s.shard_rounds
+         << ", solve time: " << solve_time << " s" << endl;
+    delete s.pool;
+  }
+  if (s.look_pool) {
+    cerr << "c lookahead: " << s.look_rounds << " rounds, " << s.probe_cnt
+         << " probes, " << s.failed_cnt << " failed literals, "
+         << s.look_threads << " threads" << endl;
+    delete s.look_pool;
+  }
+  if (s.hybrid) {
+    s.hybrid->printStats(cerr);
+    delete s.hybrid;
+  }
+  if (s.trace) {
+    cerr << "c recorded: " << s.trace->size() << " snapshots" << endl;
+    delete s.trace;
+  }
   return 0;
 }
@@ -0,0 +1,131 @@
+#include <string.h>
+
+// On-chip capacity, instances with more variables have to use kernal()
+#define MAX_VARS 4096
+// Clauses per burst
+#define TILE 1024
+// Implications collected per sweep, any beyond this are found again by the
+// next sweep
+#define MAX_IMPLIED 1024
+
+// Same contract as kernal(): clauses holds 3 literals per clause, out holds
+// the assignment (a byte of -1/0/1) indexed by variable and gets the propagated
+// assignment back with out[0] = 1 on conflict, 0 otherwise, and reasons
+// gets the conflict clause and the implications with their clauses. out[0] =
+// -1 means var_cnt is over MAX_VARS and nothing was done.
+//
+// Unlike kernal(), which stops at the first implication and rescans,
+// every sweep evaluates all clauses against a fixed assignment and only
+// collects implications, which are applied after the sweep. Nothing the
+// clause loop reads is written inside it, so it pipelines at II=1. The
+// assignment lives in two on-chip copies (each dual ported BRAM serves two
+// of the three reads per clause), clauses are streamed in bursts of TILE
+// and out is written back once at the end. Implications are listed in
+// reasons in the order they are applied.
+extern "C" void kernal_tiled(const int *clauses, signed char *out,
+                             int *reasons, int var_cnt, int clause_cnt) {
+#pragma HLS INTERFACE m_axi port = clauses offset = slave bundle = gmem0 max_read_burst_length = 256
+#pragma HLS INTERFACE m_axi port = out offset = slave bundle = gmem1
+#pragma HLS INTERFACE m_axi port = reasons offset = slave bundle = gmem2
+#pragma HLS INTERFACE s_axilite port = clauses
+#pragma HLS INTERFACE s_axilite port = out
+#pragma HLS INTERFACE s_axilite port = reasons
+#pragma HLS INTERFACE s_axilite port = var_cnt
+#pragma HLS INTERFACE s_axilite port = clause_cnt
+#pragma HLS INTERFACE s_axilite port = return
+
+  if (var_cnt > MAX_VARS) {
+    out[0] = -1;
+    return;
+  }
+
+  signed char vals0[MAX_VARS + 1], vals1[MAX_VARS + 1];
+#pragma HLS BIND_STORAGE variable = vals0 type = ram_t2p impl = bram
+#pragma HLS BIND_STORAGE variable = vals1 type = ram_t2p impl = bram
+  int tile[3 * TILE];
+#pragma HLS ARRAY_PARTITION variable = tile cyclic factor = 3
+  int implied[MAX_IMPLIED], implied_clause[MAX_IMPLIED];
+
+load_vars:
+  for (int i = 0; i <= var_cnt; i++) {
+#pragma HLS PIPELINE II = 1
+    vals0[i] = vals1[i] = out[i];
+  }
+
+  bool conflict = false, changed = true;
+  int conflict_clause = -1, reason_cnt = 0;
+  while (changed && !conflict) {
+    changed = false;
+    int implied_cnt = 0;
+
+    for (int base = 0; base < clause_cnt; base += TILE) {
+      int n = clause_cnt - base < TILE ? clause_cnt - base : TILE;
+      // Burst read
+      memcpy(tile, clauses + 3 * base, 3 * n * sizeof(int));
+
+    sweep:
+      for (int i = 0; i < n; i++) {
+#pragma HLS PIPELINE II = 1
+        int var[3], v[3];
+        bool sign[3];
+        for (int j = 0; j < 3; j++) {
+#pragma HLS UNROLL
+          int lit = tile[3 * i + j];
+          sign[j] = lit >= 0;
+          var[j] = sign[j] ? lit : -lit;
+        }
+        v[0] = vals0[var[0]];
+        v[1] = vals0[var[1]];
+        v[2] = vals1[var[2]];
+
+        // Literal values: 1 true, 0 false, -1 unassigned
+        int lv[3];
+        for (int j = 0; j < 3; j++) {
+#pragma HLS UNROLL
+          lv[j] = v[j] == -1 ? -1 : (v[j] ^ !sign[j]);
+        }
+        bool sat = lv[0] == 1 || lv[1] == 1 || lv[2] == 1;
+        int unassigned = (lv[0] == -1) + (lv[1] == -1) + (lv[2] == -1);
+
+        if (!sat && unassigned == 0) {
+          if (!conflict) conflict_clause = base + i;
+          conflict = true;
+        }
+        if (!sat && unassigned == 1 && implied_cnt < MAX_IMPLIED) {
+          int j = lv[0] == -1 ? 0 : lv[1] == -1 ? 1 : 2;
+          implied[implied_cnt] = sign[j] ? var[j] : -var[j];
+          implied_clause[implied_cnt++] = base + i;
+        }
+      }
+    }
+
+    // Two clauses may imply opposite values for the same variable, which
+    // is caught here rather than by the next sweep, the later clause is
+    // then the falsified one
+  apply:
+    for (int i = 0; i < implied_cnt && !conflict; i++) {
+      int lit = implied[i];
+      int var = lit < 0 ? -lit : lit;
+      signed char val = lit > 0;
+      if (vals0[var] == -1) {
+        vals0[var] = vals1[var] = val;
+        reasons[2 + 2 * reason_cnt] = lit;
+        reasons[3 + 2 * reason_cnt] = implied_clause[i];
+        reason_cnt++;
+        changed = true;
+      } else if (vals0[var] != val) {
+        conflict = true;
+        conflict_clause = implied_clause[i];
+      }
+    }
+  }
+
+store_vars:
+  for (int i = 1; i <= var_cnt; i++) {
+#pragma HLS PIPELINE II = 1
+    out[i] = vals0[i];
+  }
+  out[0] = conflict;
+  reasons[0] = conflict_clause;
+  reasons[1] = reason_cnt;
+}
@@ -1,103 +1,874 @@
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <vector>
 
+#include "arena.h"
+#include "check.h"
+#include "cnf.h"
+#include "daemon.h"
+#include "gauss.h"
+
 using namespace std;
 
+// Upper bound on --leaf-vars, 2^30 assignments is already far too slow
+#define MAX_LEAF_VARS 30
+#define DEFAULT_LEAF_VARS 14
+
+// Vivification runs every VIVIFY_INTERVAL conflicts, each round gets 1 /
+// VIVIFY_SHARE of the propagations made since the last one but at least
+// VIVIFY_MIN_EFFORT
+#define VIVIFY_INTERVAL 5000
+#define VIVIFY_SHARE 10
+#define VIVIFY_MIN_EFFORT 10000
+
+// Binary DRAT/LRAT writer. Records are encoded straight into a large buffer
+// and handed to write(2) in one piece, optionally from a background thread
+// so the solver only blocks if it fills a second buffer before the first one
+// is out.
+class ProofWriter {
+ public:
+  static const size_t BUF_SIZE = 1 << 24;
+
+  ProofWriter(string outfile, bool threaded);
+  ~ProofWriter();
+
+  void put(char c) {
+    if (len == buf.size()) flush();
+    buf[len++] = c;
+  }
+  // Variable length, 7 bits per byte, low bits first. At most 10 bytes.
+  static size_t encodeLit(long long lit, char *out) {
+    unsigned long long u =
+        2 * (unsigned long long)(lit < 0 ? -lit : lit) + (lit < 0);
+    size_t n = 0;
+    while (u > 127) {
+      out[n++] = (u & 127) | 128;
+      u >>= 7;
+    }
+    out[n++] = u;
+    return n;
+  }
+  void putLit(long long lit) {
+    if (len + 10 > buf.size()) flush();
+    len += encodeLit(lit, buf.data() + len);
+  }
+  // Already encoded records
+  void putBytes(const char *data, size_t n) {
+    while (n > 0) {
+      if (len == buf.size()) flush();
+      size_t k = min(n, buf.size() - len);
+      memcpy(buf.data() + len, data, k);
+      len += k;
+      data += k;
+      n -= k;
+    }
+  }
+  void flush();
+
+ private:
+  int fd;
+  vector<char> buf, spare;
+  size_t len = 0, spare_len = 0;
+
+  bool threaded, pending = false, done = false;
+  thread writer;
+  mutex m;
+  condition_variable cv;
+
+  void writeAll(const char *data, size_t n);
+  void writerLoop();
+};
+
+ProofWriter::ProofWriter(string outfile, bool threaded)
+    : buf(BUF_SIZE), threaded(threaded) {
+  // No O_TRUNC on pipes, but it is harmless there
+  fd = open(outfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    cerr << "Error: couldn't open proof file " << outfile << endl;
+    exit(1);
+  }
+  if (threaded) {
+    spare.resize(BUF_SIZE);
+    writer = thread(&ProofWriter::writerLoop, this);
+  }
+}
+
+ProofWriter::~ProofWriter() {
+  flush();
+  if (threaded) {
+    {
+      unique_lock<mutex> lock(m);
+      cv.wait(lock, [this] { return !pending; });
+      done = true;
+    }
+    cv.notify_all();
+    writer.join();
+  }
+  close(fd);
+}
+
+void ProofWriter::flush() {
+  if (!threaded) {
+    writeAll(buf.data(), len);
+    len = 0;
+    return;
+  }
+  {
+    // Wait for the writer to finish with the previous buffer, then swap
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [this] { return !pending; });
+    swap(buf, spare);
+    spare_len = len;
+    pending = true;
+  }
+  len = 0;
+  cv.notify_all();
+}
+
+void ProofWriter::writeAll(const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t written = write(fd, data, n);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      cerr << "Error: couldn't write proof: " << strerror(errno) << endl;
+      exit(1);
+    }
+    data += written;
+    n -= written;
+  }
+}
+
+void ProofWriter::writerLoop() {
+  unique_lock<mutex> lock(m);
+  while (true) {
+    cv.wait(lock, [this] { return pending || done; });
+    if (!pending) return;
+    lock.unlock();
+    writeAll(spare.data(), spare_len);
+    lock.lock();
+    pending = false;
+    cv.notify_all();
+  }
+}
+
 enum Status {
   Solved,
   Unsolvable,
+  Unknown,  // Stopped by a limit or interrupt() before finishing
+};
+
+// Search budgets, -1 for no limit
+struct Limits {
+  double time = -1;  // seconds
+  long long decisions = -1, conflicts = -1, propagations = -1;
+};
+
+// Limits spent across the components of one solve: they start the clock
+// together and count towards the same decision, conflict and propagation
+// budgets, so the limits hold for the whole solve
+struct SharedBudget {
+  chrono::steady_clock::time_point start;
+  atomic<long long> decisions{0}, conflicts{0}, propagations{0};
+};
+
+// Solver settings from the command line, applied per instance by
+// SATInstance::configure()
+struct Options {
+  Limits limits;
+  int leaf_vars = DEFAULT_LEAF_VARS;
+  bool components = true;
+  bool reorder = false;
+  bool huge_pages = false;
+  bool xors = true;
+  bool vivify = true;
+  // Check every model against the input before it is printed
+  bool verify = false;
 };
 
 class SATInstance {
  public:
   int var_cnt = 0, clause_cnt = 0;
-  // -1 (unassigned), 0 (false), 1 (true)
-  vector<int> vars = {};
-  vector<vector<int>> clauses = {};
+  // -1 (unassigned), 0 (false), 1 (true), a byte each as in the kernels
+  vector<signed char> vars = {};
+  // Everything below that is sized by the instance lives here, set up by
+  // load() so that the search itself never allocates
+  Arena arena;
+  long long search_allocs = 0;
+
+  // Clauses with other than 2 literals as read, vivification may shorten
+  // them to any length
+  vector<Span<int>> clauses = {};
+  // Binary clauses as implication lists, indexed by litIndex(lit): every
+  // literal that must become true once lit is true
+  vector<Span<int>> binImplications = {};
+  int bin_cnt = 0;
+
+  // Assigned literals in assignment order, trail[qhead..] are yet to be
+  // propagated through binImplications
+  Stack<int> trail;
+  unsigned qhead = 0;
+  bool binConflict = false;
+
+  long long propagations = 0, decision_cnt = 0, conflict_cnt = 0;
+  double solve_time = 0;
+
+  Limits limits;
+  // Why the last solve() returned Unknown
+  const char *stop_reason = "";
+  chrono::steady_clock::time_point solve_start;
+  // Set for a component, its counts so far are added to it every node
+  SharedBudget *budget = nullptr;
+  long long spent_decisions = 0, spent_conflicts = 0, spent_propagations = 0;
+  // Lock free, so interrupt() is safe from other threads and from signal
+  // handlers
+  atomic<bool> interrupted{false};
+
+  // Leaf solving: once at most leaf_vars variables are left in unsatisfied
+  // clauses the whole subtree is enumerated at once, 0 turns it off
+  int leaf_vars = DEFAULT_LEAF_VARS;
+  long long leaf_cnt = 0;
+  vector<int> leaf_index = {};  // per var, its bit in the leaf or -1
+  Stack<int> leaf_order;  // per bit, its var
+  // Unsatisfied clauses as 2 * bit + (lit < 0), leaf_ends[c] is one past
+  // the end of clause c
+  Stack<int> leaf_lits;
+  Stack<unsigned> leaf_ends;
+  Stack<unsigned long long> leaf_words;
+
+  // XORs found in the clauses, also propagated by Gaussian elimination
+  // (the clauses stay). Off with a proof, there is no DRAT for it.
+  bool use_xors = true;
+  int xor_cnt = 0;
+  Gauss gauss;
+  bool gauss_on = false;
+
+  // Vivification: every VIVIFY_INTERVAL conflicts the search steps back to
+  // the top level, tries to shorten clauses within a propagation budget and
+  // then puts its assignment back. Off with a proof.
+  bool use_vivify = true;
+  bool vivify_on = false;
+  long long next_vivify = 0, vivify_base = 0;
+  unsigned vivify_cursor = 0;
+  int vivifying = -1;  // left out of propagation while it is being probed
+  Stack<int> saved_trail, saved_reasons;
+  // Per literal index, whether a unit clause of it is in clauses
+  Stack<char> root_units;
+  long long vivify_rounds = 0, vivified_lits = 0, vivified_clauses = 0;
+  double vivify_time = 0;
+
+  // Component decomposition: after top level propagation, independent parts
+  // of what is left are solved as separate instances on component_jobs
+  // threads, 0 turns it off
+  int component_jobs = 1;
+  int component_cnt = 0;
+  vector<int> component_parent = {};  // per var, union-find
+  vector<unique_ptr<SATInstance>> components = {};
+  // How many of components interrupt() may touch, components is only
+  // resized while this is 0
+  atomic<int> live_components{0};
 
-  void read(string infile);
+  // Original number of each variable if --reorder renumbered them, empty
+  // otherwise
+  bool reorder = false;
+  vector<int> var_order = {};
+
+  // Proof logging. Clause ids are 1-based in input order, learned clauses
+  // continue after clause_cnt.
+  ProofWriter *proof = nullptr;
+  bool lrat = false;
+  vector<int> clause_ids = {};
+  vector<Span<int>> binIds = {};  // parallel to binImplications
+  vector<int> reasons = {};       // per var, 0 for decisions
+  Stack<int> decisions;
+  // -decisions already encoded for the proof, with where each literal ends,
+  // so a learned clause is copied out in one piece instead of encoding every
+  // literal of it again
+  Stack<char> negated;
+  Stack<unsigned> negated_ends;
+  int conflict_id = 0;
+  long long next_id = 0, learned_id = 0;
+  long long proof_clauses = 0;
+  Stack<long long> hints;
+
+  void configure(const Options &opts, int threads);
+  void read(string infile, bool use_cache = false, bool revalidate = false);
+  void prepare(CNF &cnf);
+  void load(const CNF &cnf);
   Status solve();
+  Status search();
+  Status solveComponents();
+  void vivify();
+  bool vivifyClause(unsigned c);
+  int findComponent(int var);
+  void interrupt();
+  bool outOfBudget();
   Status backtrack();
-  vector<int> resolveImplications();
-  int getImpliedVar();
+  void assign(int lit, int reason = 0);
+  void undo(unsigned mark);
+  void resolveImplications();
+  bool propagateBinary();
+  int getImpliedVar(int &reason);
   bool conflictExists();
+  bool solveLeaf(Status &result);
+  bool addLeafClause(const int *clause, unsigned size);
   int selectVar();
-  void printSol();
+  void printSol(ostream &out = cout);
   void printClauses();
+  void printStats();
+
+  void learnConflict();
+  void learnBranches(int var, long long false_id, long long true_id);
+  void pushNegated(int lit);
+  void popNegated();
+  void emitLearned(int extra_lit);
+  void emitDeletion(long long id, int extra_lit);
 };
 
 static int mod(int x) {
   return x < 0? -x : x;
 }
 
-void SATInstance::read(string infile) {
-  ifstream fin(infile);
-  if (!fin.is_open()) {
-    cerr << "Error: couldn't open file " << infile << endl;
-    exit(0);
-  }
-  char c;  // check if line is comment
-  string s;
-  while (true) {
-    fin >> c;
-    if (c == 'c')
-      getline(fin, s);
-    else
-      break;
-  }
-  fin >> s;
-  if (s != "cnf") {
-    cerr << "Error: expected cnf input file, given " << s << endl;
-    exit(1);
-  }
-  fin >> var_cnt >> clause_cnt;
+static int litIndex(int lit) {
+  return 2 * mod(lit) + (lit < 0);
+}
+
+// threads is what component solving may use
+void SATInstance::configure(const Options &opts, int threads) {
+  limits = opts.limits;
+  leaf_vars = opts.leaf_vars;
+  component_jobs = opts.components ? threads : 0;
+  reorder = opts.reorder;
+  use_xors = opts.xors;
+  use_vivify = opts.vivify;
+  arena.setHugePages(opts.huge_pages);
+}
+
+void SATInstance::read(string infile, bool use_cache, bool revalidate) {
+  CNF cnf;
+  if (use_cache)
+    readCached(infile, cnf, revalidate);
+  else
+    readDIMACS(infile, cnf);
+  prepare(cnf);
+}
+
+// load() after whatever preprocessing of the parsed cnf is enabled
+void SATInstance::prepare(CNF &cnf) {
+  var_order.clear();
+  if (reorder) reorderCNF(cnf, var_order);
+  load(cnf);
+}
+
+void SATInstance::load(const CNF &cnf) {
+  var_cnt = cnf.var_cnt;
+  clause_cnt = cnf.clause_cnt;
   vars.clear();
   vars.resize(var_cnt + 1);
+  leaf_index.assign(var_cnt + 1, -1);
+  arena.reset();
+
+  // Sizes first, so every list can be carved out of the arena in one go
+  vector<unsigned> bin_len(2 * (var_cnt + 1), 0);
+  size_t lit_cnt = 0;
+  bin_cnt = 0;
+  for (int i = 0; i < clause_cnt; i++) {
+    const int *clause = cnf.lits + cnf.offsets[i];
+    unsigned size = cnf.offsets[i + 1] - cnf.offsets[i];
+    if (size == 2) {
+      bin_len[litIndex(-clause[0])]++;
+      bin_len[litIndex(-clause[1])]++;
+      bin_cnt++;
+    } else
+      lit_cnt += size;
+  }
+  binImplications.assign(2 * (var_cnt + 1), Span<int>());
+  binIds.assign(2 * (var_cnt + 1), Span<int>());
+  for (unsigned l = 0; l < bin_len.size(); l++) {
+    binImplications[l].ptr = arena.alloc<int>(bin_len[l]);
+    binIds[l].ptr = arena.alloc<int>(bin_len[l]);
+  }
+  int *lits = arena.alloc<int>(lit_cnt);
   clauses.clear();
-  clauses.resize(clause_cnt);
-  int var;
-  for (int i = 0; i < clause_cnt; i++)
-    for (fin >> var; var != 0; fin >> var) clauses[i].push_back(var);
+  clause_ids.clear();
+  for (int i = 0; i < clause_cnt; i++) {
+    const int *clause = cnf.lits + cnf.offsets[i];
+    unsigned size = cnf.offsets[i + 1] - cnf.offsets[i];
+    if (size == 2) {
+      // (a v b) == (-a -> b) && (-b -> a)
+      for (int j = 0; j < 2; j++) {
+        int l = litIndex(-clause[j]);
+        binImplications[l][binImplications[l].len++] = clause[1 - j];
+        binIds[l][binIds[l].len++] = i + 1;
+      }
+    } else {
+      copy(clause, clause + size, lits);
+      clauses.push_back({lits, size});
+      clause_ids.push_back(i + 1);
+      lits += size;
+    }
+  }
+
+  trail.init(arena, var_cnt + 1);
+  decisions.init(arena, var_cnt + 1);
+  negated.init(arena, 5 * (var_cnt + 1));
+  negated_ends.init(arena, var_cnt + 1);
+  hints.init(arena, var_cnt + 2);
+  leaf_order.init(arena, MAX_LEAF_VARS);
+  leaf_words.init(arena, 2 * MAX_LEAF_VARS);
+  leaf_lits.init(arena, lit_cnt + 2 * bin_cnt);
+  leaf_ends.init(arena, clauses.size() + bin_cnt);
+  saved_trail.init(arena, var_cnt + 1);
+  saved_reasons.init(arena, var_cnt + 1);
+  root_units.init(arena, 2 * (var_cnt + 1));
+
+  vector<Xor> xors;
+  if (use_xors) findXors(cnf, xors);
+  xor_cnt = gauss.init(arena, xors, var_cnt) ? xors.size() : 0;
 }
 
 Status SATInstance::solve() {
   for (int i = 1; i <= var_cnt; i++) vars[i] = -1;
-  return backtrack();
+  trail.clear();
+  qhead = 0;
+  binConflict = false;
+  propagations = decision_cnt = conflict_cnt = leaf_cnt = 0;
+  search_allocs = 0;
+  stop_reason = "";
+  reasons.assign(var_cnt + 1, 0);
+  decisions.clear();
+  negated.clear();
+  negated_ends.clear();
+  next_id = clause_cnt + 1;
+  component_cnt = 0;
+  gauss_on = xor_cnt > 0 && !proof;
+  vivify_on = use_vivify && !proof;
+  next_vivify = vivify_base = 0;
+  vivify_cursor = 0;
+  vivify_rounds = vivified_lits = vivified_clauses = 0;
+  vivify_time = 0;
+  if (gauss_on) gauss.reset();
+  solve_start = budget ? budget->start : chrono::steady_clock::now();
+  spent_decisions = spent_conflicts = spent_propagations = 0;
+  // Components are solved without a proof of their own
+  Status s = component_jobs > 0 && !proof ? solveComponents() : search();
+  solve_time = chrono::duration<double>(chrono::steady_clock::now() -
+                                        solve_start)
+                   .count();
+  // An interrupt that raced with the end of the search is for this solve
+  // only
+  interrupted.store(false, memory_order_relaxed);
+  return s;
+}
+
+void SATInstance::interrupt() {
+  interrupted.store(true, memory_order_relaxed);
+  for (int i = 0, e = live_components.load(); i < e; i++)
+    components[i]->interrupt();
+}
+
+int SATInstance::findComponent(int var) {
+  while (component_parent[var] != var)
+    var = component_parent[var] = component_parent[component_parent[var]];
+  return var;
+}
+
+// Propagates at the top level, then splits the remaining clauses into
+// connected components (variables sharing a clause) and, if there is more
+// than one, solves each as an instance of its own, renumbered and with
+// assigned literals dropped. The first unsatisfiable one stops the rest, as
+// does the first to run out of budget, the limits being for the whole solve.
+// Otherwise the models are copied back and variables left in no clause are
+// set false.
+Status SATInstance::solveComponents() {
+  resolveImplications();
+  if (conflictExists()) {
+    conflict_cnt++;
+    return Unsolvable;
+  }
+
+  component_parent.resize(var_cnt + 1);
+  for (int v = 0; v <= var_cnt; v++) component_parent[v] = v;
+  vector<bool> active(var_cnt + 1, false);
+  // Clauses still in play: unsatisfied, with at least two literals left
+  vector<vector<int>> remaining;
+  for (const Span<int> &clause : clauses) {
+    vector<int> left;
+    bool sat = false;
+    for (int lit : clause) {
+      if (vars[mod(lit)] == -1)
+        left.push_back(lit);
+      else if (vars[mod(lit)] == (lit > 0))
+        sat = true;
+    }
+    if (sat) continue;
+    remaining.push_back(left);
+  }
+  // Binary clauses with a literal assigned are satisfied after propagation
+  for (int v = 1; v <= var_cnt; v++) {
+    if (vars[v] != -1) continue;
+    for (int lit : {v, -v})
+      for (int implied : binImplications[litIndex(lit)])
+        if (-lit < implied && vars[mod(implied)] == -1)
+          remaining.push_back({-lit, implied});
+  }
+  for (const vector<int> &clause : remaining)
+    for (int lit : clause) {
+      active[mod(lit)] = true;
+      component_parent[findComponent(mod(lit))] =
+          findComponent(mod(clause[0]));
+    }
+
+  // Number components in order of their lowest variable, and variables
+  // within each component
+  vector<int> component(var_cnt + 1, -1), local(var_cnt + 1, 0);
+  vector<vector<int>> component_vars;
+  for (int v = 1; v <= var_cnt; v++) {
+    if (!active[v]) continue;
+    int root = findComponent(v);
+    if (component[root] == -1) {
+      component[root] = component_vars.size();
+      component_vars.emplace_back();
+    }
+    component[v] = component[root];
+    component_vars[component[v]].push_back(v);
+    local[v] = component_vars[component[v]].size();
+  }
+  component_cnt = component_vars.size();
+  if (component_cnt <= 1) return search();
+
+  vector<CNF> cnfs(component_cnt);
+  for (int c = 0; c < component_cnt; c++) {
+    cnfs[c].var_cnt = component_vars[c].size();
+    cnfs[c].offset_buf.assign(1, 0);
+  }
+  for (const vector<int> &clause : remaining) {
+    CNF &cnf = cnfs[component[mod(clause[0])]];
+    for (int lit : clause)
+      cnf.lit_buf.push_back(lit < 0 ? -local[-lit] : local[lit]);
+    cnf.offset_buf.push_back(cnf.lit_buf.size());
+  }
+  components.resize(component_cnt);
+  SharedBudget shared;
+  shared.start = solve_start;
+  shared.decisions = decision_cnt;
+  shared.conflicts = conflict_cnt;
+  shared.propagations = propagations;
+  for (int c = 0; c < component_cnt; c++) {
+    CNF &cnf = cnfs[c];
+    cnf.clause_cnt = cnf.offset_buf.size() - 1;
+    cnf.lits = cnf.lit_buf.data();
+    cnf.offsets = cnf.offset_buf.data();
+    if (!components[c]) components[c].reset(new SATInstance());
+    components[c]->use_xors = use_xors;
+    components[c]->use_vivify = use_vivify;
+    components[c]->load(cnf);
+    components[c]->limits = limits;
+    components[c]->budget = &shared;
+    components[c]->leaf_vars = leaf_vars;
+    components[c]->component_jobs = 0;
+    components[c]->arena.setHugePages(arena.hugePages());
+    // Left set if it was stopped before it started last time
+    components[c]->interrupted.store(false, memory_order_relaxed);
+  }
+
+  vector<Status> results(component_cnt, Unknown);
+  atomic<int> next(0);
+  atomic<bool> unsat(false);
+  // The first component to run out of budget, whose stop reason is the
+  // solve's
+  atomic<int> stopped(-1);
+  auto worker = [&]() {
+    for (int c = next++; c < component_cnt; c = next++) {
+      if (unsat || stopped >= 0 || interrupted.load(memory_order_relaxed))
+        break;
+      results[c] = components[c]->solve();
+      bool stop = false;
+      if (results[c] == Unsolvable)
+        stop = !unsat.exchange(true);
+      else if (results[c] == Unknown) {
+        int none = -1;
+        stop = stopped.compare_exchange_strong(none, c);
+      }
+      if (stop)
+        for (int i = 0; i < component_cnt; i++)
+          if (i != c) components[i]->interrupt();
+    }
+  };
+  live_components = component_cnt;
+  // In case interrupt() came in before live_components was set
+  if (interrupted.load(memory_order_relaxed))
+    for (int c = 0; c < component_cnt; c++) components[c]->interrupt();
+  vector<thread> pool;
+  for (int i = 1; i < min(component_jobs, component_cnt); i++)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &t : pool) t.join();
+  live_components = 0;
+  for (int c = 0; c < component_cnt; c++) components[c]->budget = nullptr;
+
+  Status result = Solved;
+  for (int c = 0; c < component_cnt; c++) {
+    SATInstance &comp = *components[c];
+    decision_cnt += comp.decision_cnt;
+    conflict_cnt += comp.conflict_cnt;
+    propagations += comp.propagations;
+    leaf_cnt += comp.leaf_cnt;
+    vivify_rounds += comp.vivify_rounds;
+    vivified_lits += comp.vivified_lits;
+    vivified_clauses += comp.vivified_clauses;
+    vivify_time += comp.vivify_time;
+    search_allocs += comp.search_allocs;
+    if (results[c] == Unsolvable)
+      result = Unsolvable;
+    else if (results[c] == Unknown && result == Solved) {
+      result = Unknown;
+      SATInstance &first = *components[stopped >= 0 ? stopped.load() : c];
+      stop_reason = *first.stop_reason ? first.stop_reason : "interrupted";
+    }
+  }
+  // The others were only stopped because of this
+  if (result == Unsolvable) stop_reason = "";
+  if (result != Solved) return result;
+  for (int c = 0; c < component_cnt; c++)
+    for (unsigned i = 0; i < component_vars[c].size(); i++)
+      assign(components[c]->vars[i + 1] ? component_vars[c][i]
+                                        : -component_vars[c][i]);
+  for (int v = 1; v <= var_cnt; v++)
+    if (vars[v] == -1) assign(-v);
+  return Solved;
+}
+
+// Called once per search node. The clock is only read every 256 decisions.
+bool SATInstance::outOfBudget() {
+  long long decisions = decision_cnt, conflicts = conflict_cnt,
+            props = propagations;
+  if (budget) {
+    // What this component spent since the last node, then the total
+    decisions = budget->decisions += decision_cnt - spent_decisions;
+    conflicts = budget->conflicts += conflict_cnt - spent_conflicts;
+    props = budget->propagations += propagations - spent_propagations;
+    spent_decisions = decision_cnt;
+    spent_conflicts = conflict_cnt;
+    spent_propagations = propagations;
+  }
+  if (interrupted.load(memory_order_relaxed))
+    stop_reason = "interrupted";
+  else if (limits.decisions >= 0 && decisions >= limits.decisions)
+    stop_reason = "decision limit";
+  else if (limits.conflicts >= 0 && conflicts >= limits.conflicts)
+    stop_reason = "conflict limit";
+  else if (limits.propagations >= 0 && props >= limits.propagations)
+    stop_reason = "propagation limit";
+  else if (limits.time >= 0 && (decision_cnt & 255) == 0 &&
+           chrono::duration<double>(chrono::steady_clock::now() -
+                                    solve_start)
+                   .count() >= limits.time)
+    stop_reason = "time limit";
+  else
+    return false;
+  return true;
+}
+
+// The search proper, which does all its work in memory set up by load().
+// Counts the heap allocations it makes anyway for the stats.
+Status SATInstance::search() {
+  long long before = threadAllocations();
+  Status s = backtrack();
+  search_allocs += threadAllocations() - before;
+  return s;
 }
 
 Status SATInstance::backtrack() {
-  vector<int> implied = resolveImplications();
+  // Unknown unwinds straight to solve(), which resets everything anyway
+  if (outOfBudget()) return Unknown;
+  if (vivify_on && conflict_cnt >= next_vivify) vivify();
+  unsigned mark = trail.size();
+  resolveImplications();
   if (conflictExists()) {
     // Current (partial) assignment causes conflict, undo implications and
     // backtrack
-    for (auto var : implied) vars[var] = -1;
+    conflict_cnt++;
+    if (proof) learnConflict();
+    undo(mark);
     return Unsolvable;
   }
+  // Enumeration has nothing to put in a proof
+  Status leaf;
+  if (leaf_vars > 0 && !proof && solveLeaf(leaf)) {
+    if (leaf == Unsolvable) undo(mark);
+    return leaf;
+  }
   int var = selectVar();
   if (var == var_cnt + 1)
     return Solved;  // All variables are assigned with no conflict, we are done
+  unsigned decision = trail.size();
   // Try to recurse by assigning current var false
-  vars[var] = 0;
+  decisions.push_back(-var);
+  if (proof) pushNegated(var);
+  assign(-var);
+  decision_cnt++;
   Status s = backtrack();
-  if (s == Solved)
-    return Solved;  // Yay! False for current var worked!
+  if (s != Unsolvable)
+    return s;  // Yay! False for current var worked! (or we ran out of budget)
   else {
     // False didn't work, try if true works
-    vars[var] = 1;
+    long long false_id = learned_id;
+    undo(decision);
+    decisions.back() = var;
+    if (proof) {
+      popNegated();
+      pushNegated(-var);
+    }
+    assign(var);
+    decision_cnt++;
     s = backtrack();
-    if (s == Solved)
-      return Solved;  // Yay! True for current var worked!
+    if (s != Unsolvable)
+      return s;  // Yay! True for current var worked!
     else {
       // Both didn't work, backtrack by leaving current var unassigned
-      vars[var] = -1;
-      for (auto var : implied) vars[var] = -1;
+      decisions.pop_back();
+      if (proof) popNegated();
+      undo(mark);
+      if (proof) learnBranches(var, false_id, learned_id);
       return Unsolvable;
     }
   }
 }
 
+// One round of vivification. Clauses are only ever replaced by shorter ones
+// the formula implies, or dropped once a unit clause satisfies them, so the
+// search can carry on with the same assignment.
+void SATInstance::vivify() {
+  auto start = chrono::steady_clock::now();
+  vivify_rounds++;
+  long long search_propagations = propagations;
+  long long budget =
+      max((long long)VIVIFY_MIN_EFFORT,
+          (propagations - vivify_base) / VIVIFY_SHARE);
+  saved_trail.clear();
+  saved_reasons.clear();
+  for (int lit : trail) {
+    saved_trail.push_back(lit);
+    saved_reasons.push_back(reasons[mod(lit)]);
+  }
+  unsigned saved_qhead = qhead;
+  undo(0);
+  root_units.resize(2 * (var_cnt + 1));
+  fill(root_units.begin(), root_units.end(), 0);
+  for (auto &clause : clauses)
+    if (clause.size() == 1) root_units[litIndex(clause[0])] = 1;
+
+  propagations = 0;
+  resolveImplications();
+  // Unsatisfiable at the top level, the search finds out soon enough
+  if (!conflictExists())
+    for (size_t n = 0; n < clauses.size() && propagations < budget &&
+                       !interrupted.load(memory_order_relaxed);
+         n++) {
+      if (vivify_cursor >= clauses.size()) vivify_cursor = 0;
+      if (!vivifyClause(vivify_cursor)) vivify_cursor++;
+    }
+
+  undo(0);
+  for (unsigned i = 0; i < saved_trail.size(); i++)
+    assign(saved_trail[i], saved_reasons[i]);
+  qhead = saved_qhead;
+  propagations = search_propagations;
+  vivify_base = propagations;
+  next_vivify = conflict_cnt + VIVIFY_INTERVAL;
+  vivify_time +=
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Assigns the negation of clause c one literal at a time (propagating
+// with c itself left out) until that conflicts or makes a literal of c
+// true. The literals assigned so far (plus that one) then form a clause the
+// rest implies, and literals of c made false along the way are implied
+// false by them, either way c can be cut down to what was assigned.
+// A clause satisfied at the top level is removed only if a unit clause of
+// the satisfying literal is there to take its place, otherwise it becomes
+// that unit: top level assignments are undone by the search like any other,
+// so they can't be what keeps a clause satisfied. Returns true if c was
+// removed, with the last clause moved into its place.
+bool SATInstance::vivifyClause(unsigned c) {
+  Span<int> &clause = clauses[c];
+  for (int lit : clause)
+    if (vars[mod(lit)] == (lit > 0)) {
+      if (clause.size() == 1) return false;
+      if (!root_units[litIndex(lit)]) {
+        root_units[litIndex(lit)] = 1;
+        vivified_lits += clause.size() - 1;
+        clause[0] = lit;
+        clause.len = 1;
+        return false;
+      }
+      clause = clauses.back();
+      clauses.pop_back();
+      clause_ids[c] = clause_ids.back();
+      clause_ids.pop_back();
+      vivified_clauses++;
+      return true;
+    }
+  if (clause.size() < 2) return false;
+
+  unsigned mark = trail.size();
+  vivifying = c;
+  unsigned kept = 0;
+  bool implied = false;
+  for (unsigned i = 0; i < clause.size() && !implied; i++) {
+    int lit = clause[i];
+    int val = vars[mod(lit)];
+    if (val == (lit > 0)) {
+      clause[kept++] = lit;
+      implied = true;
+    } else if (val == -1) {
+      clause[kept++] = lit;
+      assign(-lit);
+      resolveImplications();
+      implied = conflictExists();
+    }
+  }
+  undo(mark);
+  vivifying = -1;
+  vivified_lits += clause.size() - kept;
+  clause.len = kept;
+  if (kept == 1) root_units[litIndex(clause[0])] = 1;
+  return false;
+}
+
+void SATInstance::assign(int lit, int reason) {
+  vars[mod(lit)] = lit < 0 ? 0 : 1;
+  reasons[mod(lit)] = reason;
+  trail.push_back(lit);
+}
+
+// Unassign everything on the trail after mark
+void SATInstance::undo(unsigned mark) {
+  if (gauss_on) gauss.undo(trail, mark);
+  while (trail.size() > mark) {
+    vars[mod(trail.back())] = -1;
+    trail.pop_back();
+  }
+  qhead = min(qhead, mark);
+  binConflict = false;
+}
+
 // Select next variable to try, insert any heuristics if desired
 int SATInstance::selectVar() {
   for (int i = 1; i <= var_cnt; i++)
@@ -105,19 +876,49 @@ int SATInstance::selectVar() {
   return var_cnt + 1;
 }
 
-vector<int> SATInstance::resolveImplications() {
-  vector<int> implied;
-  for (int impliedVar = getImpliedVar(); impliedVar != 0;
-       impliedVar = getImpliedVar()) {
-    vars[mod(impliedVar)] = impliedVar < 0 ? 0 : 1;
-    implied.push_back(mod(impliedVar));
+// Binary clauses are propagated first, the (much more expensive) scan over
+// the remaining clauses only runs once they reach a fixpoint
+void SATInstance::resolveImplications() {
+  int reason;
+  while (propagateBinary()) {
+    // XORs before the clause scan, they have no reason clause
+    int impliedVar = gauss_on ? gauss.propagate(trail) : 0;
+    if (gauss_on && gauss.conflict()) break;
+    reason = 0;
+    if (impliedVar == 0) impliedVar = getImpliedVar(reason);
+    if (impliedVar == 0) break;
+    assign(impliedVar, reason);
+    propagations++;
   }
-  return implied;
 }
 
-int SATInstance::getImpliedVar() {
-  for (auto clause : clauses) {
-    int unassigned_cnt = 0, unassigned_i;
+// Returns false on conflict
+bool SATInstance::propagateBinary() {
+  while (qhead < trail.size()) {
+    int lit = trail[qhead++];
+    const Span<int> &implications = binImplications[litIndex(lit)];
+    for (unsigned i = 0; i < implications.size(); i++) {
+      int implied = implications[i];
+      int val = vars[mod(implied)];
+      if (val == -1) {
+        assign(implied, binIds[litIndex(lit)][i]);
+        propagations++;
+      } else if (val == (implied < 0)) {
+        binConflict = true;
+        conflict_id = binIds[litIndex(lit)][i];
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// reason is set to the id of the clause that implied the returned literal
+int SATInstance::getImpliedVar(int &reason) {
+  for (unsigned c = 0; c < clauses.size(); c++) {
+    if ((int)c == vivifying) continue;
+    const Span<int> &clause = clauses[c];
+    int unassigned_cnt = 0, unassigned_i = 0;
     bool clause_val = false;
     for (auto i : clause) {
       if (vars[mod(i)] == -1) {
@@ -128,13 +929,19 @@ int SATInstance::getImpliedVar() {
     }
     // Exactly one unassigned var, and rest of the clause evals to false =>
     // found implied var
-    if (unassigned_cnt == 1 && !clause_val) return unassigned_i;
+    if (unassigned_cnt == 1 && !clause_val) {
+      reason = clause_ids[c];
+      return unassigned_i;
+    }
   }
   return 0;
 }
 
 bool SATInstance::conflictExists() {
-  for (auto clause : clauses) {
+  if (binConflict || (gauss_on && gauss.conflict())) return true;
+  for (unsigned c = 0; c < clauses.size(); c++) {
+    if ((int)c == vivifying) continue;
+    const Span<int> &clause = clauses[c];
     bool clause_val = false;
     for (auto var : clause) {
       if (vars[mod(var)] == -1)
@@ -143,16 +950,178 @@ bool SATInstance::conflictExists() {
         clause_val |= var < 0 ? !vars[-var] : vars[var];
       if (clause_val) break;
     }
-    if (!clause_val) return true;
+    if (!clause_val) {
+      conflict_id = clause_ids[c];
+      return true;
+    }
   }
   return false;
 }
 
-void SATInstance::printSol() {
-  cout << "s SATISFIABLE" << endl;
-  cout << "v ";
-  for (int i = 1; i <= var_cnt; i++) cout << (vars[i] ? i : -i) << " ";
-  cout << endl;
+// Bit j of a word of assignments for variable j < 6, the assignments being
+// numbered by the word index followed by the bit index
+static const unsigned long long LEAF_PATTERNS[6] = {
+    0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+    0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL};
+
+// Returns false if more than leaf_vars variables appear in unsatisfied
+// clauses. Otherwise every assignment to them is tried, 64 at a time: each
+// variable becomes a word holding its value under 64 assignments, so a
+// clause is an OR of words and the formula an AND of clauses. result is
+// Solved (with every variable assigned) if one satisfies them all and
+// Unsolvable if none does.
+bool SATInstance::solveLeaf(Status &result) {
+  leaf_order.clear();
+  leaf_lits.clear();
+  leaf_ends.clear();
+  bool fits = true;
+  for (unsigned c = 0; c < clauses.size() && fits; c++)
+    fits = addLeafClause(clauses[c].data(), clauses[c].size());
+  // Binary clauses with a literal assigned are satisfied after propagation.
+  // Each one shows up in two lists, take it once.
+  for (int v = 1; v <= var_cnt && fits; v++) {
+    if (vars[v] != -1) continue;
+    for (int lit : {v, -v})
+      for (int implied : binImplications[litIndex(lit)]) {
+        int clause[2] = {-lit, implied};
+        if (-lit < implied && fits) fits = addLeafClause(clause, 2);
+      }
+  }
+  int k = leaf_order.size();
+  if (fits) {
+    leaf_cnt++;
+    leaf_words.resize(2 * k);
+    for (int j = 0; j < min(k, 6); j++) {
+      leaf_words[2 * j] = LEAF_PATTERNS[j];
+      leaf_words[2 * j + 1] = ~LEAF_PATTERNS[j];
+    }
+    unsigned long long word_cnt = k <= 6 ? 1 : 1ULL << (k - 6);
+    unsigned long long valid = k >= 6 ? ~0ULL : (1ULL << (1 << k)) - 1;
+    result = Unsolvable;
+    for (unsigned long long w = 0; w < word_cnt; w++) {
+      for (int j = 6; j < k; j++) {
+        leaf_words[2 * j] = (w >> (j - 6)) & 1 ? ~0ULL : 0;
+        leaf_words[2 * j + 1] = ~leaf_words[2 * j];
+      }
+      unsigned long long sat = valid;
+      unsigned begin = 0;
+      for (unsigned end : leaf_ends) {
+        unsigned long long clause = 0;
+        for (unsigned i = begin; i < end; i++)
+          clause |= leaf_words[leaf_lits[i]];
+        sat &= clause;
+        if (!sat) break;
+        begin = end;
+      }
+      if (!sat) continue;
+      unsigned long long m = w << 6 | __builtin_ctzll(sat);
+      for (int j = 0; j < k; j++)
+        assign((m >> j) & 1 ? leaf_order[j] : -leaf_order[j]);
+      // Whatever is left appears in no unsatisfied clause
+      for (int v = 1; v <= var_cnt; v++)
+        if (vars[v] == -1) assign(-v);
+      result = Solved;
+      break;
+    }
+  }
+  for (int var : leaf_order) leaf_index[var] = -1;
+  return fits;
+}
+
+// Adds clause to the leaf unless it is satisfied, returns false if that
+// takes the leaf over leaf_vars variables
+bool SATInstance::addLeafClause(const int *clause, unsigned size) {
+  for (unsigned i = 0; i < size; i++)
+    if (vars[mod(clause[i])] == (clause[i] > 0)) return true;
+  for (unsigned i = 0; i < size; i++) {
+    int var = mod(clause[i]);
+    if (vars[var] != -1) continue;
+    if (leaf_index[var] == -1) {
+      if ((int)leaf_order.size() == leaf_vars) return false;
+      leaf_index[var] = leaf_order.size();
+      leaf_order.push_back(var);
+    }
+    leaf_lits.push_back(2 * leaf_index[var] + (clause[i] < 0));
+  }
+  leaf_ends.push_back(leaf_lits.size());
+  return true;
+}
+
+// The current decisions lead to a conflict by propagation alone, so their
+// negation is RUP. For LRAT the hints are the reasons of every implied
+// literal in trail order followed by the conflicting clause.
+void SATInstance::learnConflict() {
+  hints.clear();
+  if (lrat) {
+    for (int lit : trail)
+      if (reasons[mod(lit)]) hints.push_back(reasons[mod(lit)]);
+    hints.push_back(conflict_id);
+  }
+  emitLearned(0);
+}
+
+// Both branches on var failed, each leaving behind (-decisions v +-var), so
+// -decisions follows from those two and they are no longer needed.
+void SATInstance::learnBranches(int var, long long false_id,
+                                long long true_id) {
+  hints.clear();
+  if (lrat) {
+    hints.push_back(false_id);
+    hints.push_back(true_id);
+  }
+  emitLearned(0);
+  emitDeletion(false_id, var);
+  emitDeletion(true_id, -var);
+}
+
+void SATInstance::pushNegated(int lit) {
+  negated.resize(negated.size() + ProofWriter::encodeLit(lit, negated.end()));
+  negated_ends.push_back(negated.size());
+}
+
+void SATInstance::popNegated() {
+  negated_ends.pop_back();
+  negated.resize(negated_ends.empty() ? 0 : negated_ends.back());
+}
+
+// Adds the clause -decisions (plus extra_lit if non zero)
+void SATInstance::emitLearned(int extra_lit) {
+  learned_id = next_id++;
+  proof_clauses++;
+  proof->put('a');
+  if (lrat) proof->putLit(learned_id);
+  proof->putBytes(negated.begin(), negated.size());
+  if (extra_lit) proof->putLit(extra_lit);
+  proof->put(0);
+  if (lrat) {
+    for (long long hint : hints) proof->putLit(hint);
+    proof->put(0);
+  }
+}
+
+void SATInstance::emitDeletion(long long id, int extra_lit) {
+  proof->put('d');
+  if (lrat)
+    proof->putLit(id);
+  else {
+    proof->putBytes(negated.begin(), negated.size());
+    proof->putLit(extra_lit);
+  }
+  proof->put(0);
+}
+
+void SATInstance::printSol(ostream &out) {
+  out << "s SATISFIABLE" << endl;
+  out << "v ";
+  if (var_order.empty()) {
+    for (int i = 1; i <= var_cnt; i++) out << (vars[i] ? i : -i) << " ";
+  } else {
+    // Back in input numbering
+    vector<signed char> model(var_cnt + 1);
+    for (int i = 1; i <= var_cnt; i++) model[var_order[i]] = vars[i];
+    for (int i = 1; i <= var_cnt; i++) out << (model[i] ? i : -i) << " ";
+  }
+  out << endl;
 }
 
 void SATInstance::printClauses() {
@@ -160,19 +1129,329 @@ void SATInstance::printClauses() {
     for (auto var : clause) cout << var << " ";
     cout << endl;
   }
+  for (int lit = -var_cnt; lit <= var_cnt; lit++) {
+    if (lit == 0) continue;
+    // Each binary clause shows up in two lists, print it once
+    for (int implied : binImplications[litIndex(lit)])
+      if (-lit < implied) cout << -lit << " " << implied << " " << endl;
+  }
 }
 
-int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    cerr << "Error: incorrect usage. Expected: ./a.out filename.cnf" << endl;
+void SATInstance::printStats() {
+  cerr << "c binary clauses: " << bin_cnt << endl;
+  cerr << "c decisions: " << decision_cnt << endl;
+  cerr << "c conflicts: " << conflict_cnt << endl;
+  cerr << "c propagations: " << propagations << endl;
+  cerr << "c solve time: " << solve_time << " s" << endl;
+  cerr << "c propagations/sec: "
+       << (solve_time > 0 ? propagations / solve_time : 0) << endl;
+  if (leaf_vars > 0) cerr << "c leaf solves: " << leaf_cnt << endl;
+  if (vivify_rounds > 0)
+    cerr << "c vivification: " << vivify_rounds << " rounds, "
+         << vivified_lits << " literals and " << vivified_clauses
+         << " clauses removed, " << vivify_time << " s" << endl;
+  if (component_cnt > 1) cerr << "c components: " << component_cnt << endl;
+  if (xor_cnt > 0)
+    cerr << "c xors: " << xor_cnt << " over " << gauss.cols()
+         << " variables, " << gauss.eliminations() << " row eliminations"
+         << (gauss_on ? "" : " (off with a proof)") << endl;
+  if (proof) cerr << "c proof clauses: " << proof_clauses << endl;
+  // Components bring arenas of their own
+  size_t used = arena.used(), peak = arena.peak(), reserved = arena.reserved();
+  for (auto &comp : components) {
+    used += comp->arena.used();
+    peak += comp->arena.peak();
+    reserved += comp->arena.reserved();
+  }
+  cerr << "c memory: " << used / 1024 << " KB in arena (peak " << peak / 1024
+       << " KB), " << reserved / 1024 << " KB reserved, huge pages "
+       << (arena.hugePages() ? "on" : "off") << endl;
+  cerr << "c search allocations: " << search_allocs << endl;
+  if (*stop_reason) cerr << "c stopped by: " << stop_reason << endl;
+}
+
+static const char *resultLine(Status s) {
+  if (s == Solved) return "s SATISFIABLE";
+  return s == Unsolvable ? "UNSATISFIABLE" : "s UNKNOWN";
+}
+
+// The model printSol() prints, for --verify to check against the formula as
+// given rather than anything the solver made of it
+static PackedModel packedModel(const SATInstance &s) {
+  PackedModel model;
+  model.assign(s.vars.data(), s.var_cnt, s.var_order);
+  return model;
+}
+
+static void usage() {
+  cerr << "Error: incorrect usage. Expected: ./a.out [--proof=file] [--lrat] "
+          "[--proof-thread] [--cache|--cache-revalidate] [--leaf-vars=n] "
+          "[--jobs=n] "
+          "[--no-components] [--no-xors] [--no-vivify] [--reorder] "
+          "[--huge-pages] [--verify] [limits] filename.cnf\n"
+          "   or: ./a.out --batch=list.txt [--jobs=n] "
+          "[--cache|--cache-revalidate] "
+          "[--leaf-vars=n] [--no-components] [--no-xors] [--no-vivify] "
+          "[--reorder] [--huge-pages] [--verify]\n"
+          "   or: ./a.out --daemon=socket [--leaf-vars=n] [--jobs=n] "
+          "[--no-components] [--no-xors] [--no-vivify] [--reorder] "
+          "[--huge-pages] [--verify] [limits]\n"
+          "limits: --time-limit=seconds --decision-limit=n "
+          "--conflict-limit=n --propagation-limit=n, per component when "
+          "they are solved apart\n"
+          "--leaf-vars: enumerate subtrees with at most n (0 to "
+       << MAX_LEAF_VARS << ") variables left, 0 is off, default "
+       << DEFAULT_LEAF_VARS
+       << "\n--cache-revalidate: as --cache, but also hash the input to catch "
+          "changes that kept its size and mtime"
+       << "\n--no-xors: don't recover XORs for Gaussian elimination"
+       << "\n--no-vivify: don't shorten clauses every " << VIVIFY_INTERVAL
+       << " conflicts"
+       << "\n--huge-pages: ask for transparent huge pages for the arena"
+       << "\n--verify: check every model against the input before printing "
+          "it, a model that fails is reported as an error instead"
+       << endl;
+  exit(0);
+}
+
+// fsatd mode: one SATInstance answers every job sent to socket_path, see
+// daemon.h for the protocol
+static void runDaemon(string socket_path, const Options &opts, int jobs) {
+  SATInstance s;
+  s.configure(opts, jobs);
+  serve(socket_path, [&](const string &job) {
+    ostringstream out;
+    auto start = chrono::steady_clock::now();
+    istringstream in(job);
+    CNF cnf;
+    string error;
+    if (!parseDIMACS(in, cnf, error)) {
+      out << "c error: " << error << "\n";
+      return out.str();
+    }
+    s.prepare(cnf);
+    double parse_time =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    Status result = s.solve();
+    if (result == Solved && opts.verify &&
+        !checkModel(job.data(), job.size(), packedModel(s), jobs, error)) {
+      out << "c error: model check failed, " << error << "\n";
+      return out.str();
+    }
+    if (result == Solved)
+      s.printSol(out);
+    else
+      out << resultLine(result) << "\n";
+    if (result == Unknown) out << "c stopped by: " << s.stop_reason << "\n";
+    out << "c parse time: " << parse_time << " s\n";
+    out << "c solve time: " << s.solve_time << " s\n";
+    return out.str();
+  });
+}
+
+// Solves every file listed (one per line) in list_file on a pool of jobs
+// threads, each reusing one SATInstance across its jobs. Results are
+// printed in list order as "file SAT|UNSAT seconds" as soon as every file
+// before them is done.
+// The jobs threads are all busy with files, components of a file are
+// solved one after the other.
+static void runBatch(string list_file, int jobs, bool use_cache,
+                     bool revalidate, const Options &opts) {
+  ifstream fin(list_file);
+  if (!fin.is_open()) {
+    cerr << "Error: couldn't open file " << list_file << endl;
     exit(0);
   }
+  vector<string> files;
+  for (string line; getline(fin, line);)
+    if (!line.empty()) files.push_back(line);
+
+  vector<string> results(files.size());
+  vector<bool> done(files.size(), false);
+  mutex m;
+  condition_variable cv;
+  atomic<size_t> next(0);
+
+  auto start = chrono::steady_clock::now();
+  auto worker = [&]() {
+    SATInstance s;
+    s.configure(opts, 1);
+    for (size_t i = next++; i < files.size(); i = next++) {
+      string result, error;
+      auto job_start = chrono::steady_clock::now();
+      CNF cnf;
+      if (!(use_cache ? tryReadCached(files[i], cnf, error, revalidate)
+                      : tryReadDIMACS(files[i], cnf, error)))
+        result = "ERROR";
+      else {
+        s.prepare(cnf);
+        Status status = s.solve();
+        result = status == Solved ? "SAT"
+                                  : status == Unsolvable ? "UNSAT" : "UNKNOWN";
+        // Every thread is busy with a file, the check gets one too
+        if (status == Solved && opts.verify &&
+            !checkModelFile(files[i], packedModel(s), 1, error))
+          result = "ERROR";
+        result += " " + to_string(chrono::duration<double>(
+                                      chrono::steady_clock::now() - job_start)
+                                      .count());
+      }
+      lock_guard<mutex> lock(m);
+      if (!error.empty())
+        cerr << "Warning: " << files[i] << ": " << error << endl;
+      results[i] = result;
+      done[i] = true;
+      cv.notify_all();
+    }
+  };
+  vector<thread> pool;
+  for (int i = 0; i < jobs; i++) pool.emplace_back(worker);
+
+  for (size_t i = 0; i < files.size(); i++) {
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [&] { return done[i]; });
+    cout << files[i] << " " << results[i] << "\n";
+    // Flush whenever we would otherwise wait, so results stream out
+    if (i + 1 < files.size() && !done[i + 1]) cout << flush;
+  }
+  cout << flush;
+  for (auto &t : pool) t.join();
+
+  double elapsed =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cerr << "c batch: " << files.size() << " instances, " << jobs
+       << " threads, " << elapsed << " s, "
+       << (elapsed > 0 ? files.size() / elapsed : 0) << " instances/sec"
+       << endl;
+}
+
+// Counts hardware cache misses of this thread and any it starts from here
+// on. -1 if there is no such counter (VMs often have no PMU) or
+// perf_event_paranoid forbids it.
+static int openCacheMissCounter() {
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Whatever main() is solving, for the signal handler
+static SATInstance *running = nullptr;
+
+static void onSignal(int) {
+  if (running) running->interrupt();
+}
+
+int main(int argc, char* argv[]) {
+  string infile, proof_file, batch_file, socket_path;
+  bool lrat = false, proof_thread = false, use_cache = false,
+       revalidate = false;
+  int jobs = max(1u, thread::hardware_concurrency());
+  Options opts;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg.rfind("--proof=", 0) == 0)
+      proof_file = arg.substr(strlen("--proof="));
+    else if (arg == "--lrat")
+      lrat = true;
+    else if (arg == "--proof-thread")
+      proof_thread = true;
+    else if (arg == "--cache")
+      use_cache = true;
+    else if (arg == "--cache-revalidate")
+      use_cache = revalidate = true;
+    else if (arg.rfind("--batch=", 0) == 0)
+      batch_file = arg.substr(strlen("--batch="));
+    else if (arg.rfind("--daemon=", 0) == 0)
+      socket_path = arg.substr(strlen("--daemon="));
+    else if (arg.rfind("--jobs=", 0) == 0)
+      jobs = max(1, atoi(arg.c_str() + strlen("--jobs=")));
+    else if (arg == "--no-components")
+      opts.components = false;
+    else if (arg == "--reorder")
+      opts.reorder = true;
+    else if (arg == "--no-vivify")
+      opts.vivify = false;
+    else if (arg == "--no-xors")
+      opts.xors = false;
+    else if (arg == "--huge-pages")
+      opts.huge_pages = true;
+    else if (arg == "--verify")
+      opts.verify = true;
+    else if (arg.rfind("--leaf-vars=", 0) == 0)
+      opts.leaf_vars = atoi(arg.c_str() + strlen("--leaf-vars="));
+    else if (arg.rfind("--time-limit=", 0) == 0)
+      opts.limits.time = atof(arg.c_str() + strlen("--time-limit="));
+    else if (arg.rfind("--decision-limit=", 0) == 0)
+      opts.limits.decisions = atoll(arg.c_str() + strlen("--decision-limit="));
+    else if (arg.rfind("--conflict-limit=", 0) == 0)
+      opts.limits.conflicts = atoll(arg.c_str() + strlen("--conflict-limit="));
+    else if (arg.rfind("--propagation-limit=", 0) == 0)
+      opts.limits.propagations =
+          atoll(arg.c_str() + strlen("--propagation-limit="));
+    else if (arg[0] != '-' && infile.empty())
+      infile = arg;
+    else
+      usage();
+  }
+  if (proof_file.empty() && (lrat || proof_thread)) usage();
+  if (opts.leaf_vars < 0 || opts.leaf_vars > MAX_LEAF_VARS) usage();
+  // Proofs would have to be renumbered back, clause ids included
+  if (opts.reorder && !proof_file.empty()) usage();
+  if (!socket_path.empty()) {
+    if (!infile.empty() || !proof_file.empty() || !batch_file.empty())
+      usage();
+    runDaemon(socket_path, opts, jobs);
+    return 0;
+  }
+  if (!batch_file.empty()) {
+    // Proofs are per instance, there is no sensible single proof file
+    if (!infile.empty() || !proof_file.empty()) usage();
+    runBatch(batch_file, jobs, use_cache, revalidate, opts);
+    return 0;
+  }
+  if (infile.empty()) usage();
 
   SATInstance s;
-  s.read(argv[1]);
-  if (s.solve() == Solved)
+  s.configure(opts, jobs);
+  s.read(infile, use_cache, revalidate);
+  // ^C stops the search but still reports how far it got
+  running = &s;
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  if (!proof_file.empty()) {
+    s.proof = new ProofWriter(proof_file, proof_thread);
+    s.lrat = lrat;
+  }
+  int misses_fd = openCacheMissCounter();
+  Status result = s.solve();
+  long long misses = -1;
+  if (misses_fd < 0 || read(misses_fd, &misses, sizeof(misses)) < 0)
+    misses = -1;
+  // Make sure the proof is complete before anyone acts on the answer
+  delete s.proof;
+  double verify_time = -1;
+  if (result == Solved && opts.verify) {
+    auto start = chrono::steady_clock::now();
+    string error;
+    if (!checkModelFile(infile, packedModel(s), jobs, error)) {
+      cerr << "Error: model check failed, " << error << endl;
+      exit(1);
+    }
+    verify_time =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+  if (result == Solved)
     s.printSol();
   else
-    cout << "UNSATISFIABLE" << endl;
+    cout << resultLine(result) << endl;
+  s.printStats();
+  if (verify_time >= 0)
+    cerr << "c model verified: " << verify_time << " s" << endl;
+  if (misses >= 0) cerr << "c cache misses: " << misses << endl;
   return 0;
 }
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+
+// CPU reference for the kernels, naive.cpp's getImpliedVar()/conflictExists()
+// on the kernels' clause buffer: a scan for the first unit clause per
+// implication, then one for a falsified clause. Same contract as kernal(),
+// which finds the same implications in the same order, so it gives the same
+// reasons too.
+void naiveScan(const int *clauses, signed char *out, int *reasons,
+               int var_cnt, int clause_cnt) {
+  int implied_cnt = 0;
+  for (;;) {
+    int implied = 0, reason = -1;
+    for (int c = 0; c < clause_cnt && !implied; c++) {
+      int unassigned_cnt = 0, unassigned_lit = 0;
+      bool sat = false;
+      for (int j = 0; j < 3; j++) {
+        int lit = clauses[3 * c + j];
+        int val = out[abs(lit)];
+        if (val == -1) {
+          unassigned_cnt++;
+          unassigned_lit = lit;
+        } else
+          sat |= val == (lit > 0);
+      }
+      if (unassigned_cnt == 1 && !sat) {
+        implied = unassigned_lit;
+        reason = c;
+      }
+    }
+    if (implied == 0) break;
+    out[abs(implied)] = implied > 0;
+    reasons[2 + 2 * implied_cnt] = implied;
+    reasons[3 + 2 * implied_cnt] = reason;
+    implied_cnt++;
+  }
+  reasons[1] = implied_cnt;
+  out[0] = 0;
+  reasons[0] = -1;
+  for (int c = 0; c < clause_cnt && !out[0]; c++) {
+    bool sat = false;
+    for (int j = 0; j < 3; j++) {
+      int lit = clauses[3 * c + j];
+      sat |= out[abs(lit)] == -1 || out[abs(lit)] == (lit > 0);
+    }
+    out[0] = !sat;
+    if (!sat) reasons[0] = c;
+  }
+}
@@ -0,0 +1,173 @@
+// Propagation micro-benchmark. Replays the assignments recorded by
+// kernal_test --record through every CPU propagator on the same clauses, so
+// they are compared on identical inputs instead of inside searches that take
+// different paths. Each propagator runs whole passes over the trace until
+// --min-time has gone by and the median pass is reported, less the time it
+// takes to copy the snapshots in (the copy row). Results are checked against
+// kernal(): the conflict flag always, the assignment when there is no
+// conflict.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cnf.h"
+#include "trace.h"
+
+using namespace std;
+
+void kernal(int *clauses, signed char *out, int *reasons, int var_cnt,
+            int clause_cnt);
+extern "C" void kernal_tiled(const int *clauses, signed char *out,
+                             int *reasons, int var_cnt, int clause_cnt);
+void kernal_simd(const int *clauses, signed char *out, int *reasons,
+                 int var_cnt, int clause_cnt);
+void naiveScan(const int *clauses, signed char *out, int *reasons,
+               int var_cnt, int clause_cnt);
+bool setSimdLevel(string name);
+
+struct Propagator {
+  string name;
+  // For kernal_simd, the level to set first
+  const char *simd;
+  function<void(const int *, signed char *, int *, int, int)> run;
+};
+
+int main(int argc, char *argv[]) {
+  bool reorder = false;
+  double min_time = 0.5;
+  string filter;
+  for (int i = 1; i < argc - 2; i++) {
+    string arg = argv[i];
+    if (arg == "--reorder")
+      reorder = true;
+    else if (arg.rfind("--min-time=", 0) == 0)
+      min_time = atof(arg.c_str() + strlen("--min-time="));
+    else if (arg.rfind("--filter=", 0) == 0)
+      filter = arg.substr(strlen("--filter="));
+    else
+      argc = 0;
+  }
+  if (argc < 3) {
+    cerr << "Error: incorrect usage. Expected: ./propbench [--reorder] "
+            "[--min-time=seconds] [--filter=name] filename.cnf trace"
+         << endl;
+    exit(0);
+  }
+
+  CNF cnf;
+  readDIMACS(argv[argc - 2], cnf);
+  vector<int> order;
+  if (reorder) reorderCNF(cnf, order);
+  int var_cnt = cnf.var_cnt, clause_cnt = cnf.clause_cnt;
+  vector<int> clauses;
+  string error;
+  if (!kernelClauses(cnf, clauses, error)) {
+    cerr << "Error: " << error << endl;
+    exit(1);
+  }
+  vector<signed char> snapshots;
+  readTrace(argv[argc - 1], clauses, var_cnt, reorder, snapshots);
+  size_t stride = var_cnt + 1;
+  size_t snapshot_cnt = snapshots.size() / stride;
+  if (snapshot_cnt == 0) {
+    cerr << "Error: the trace is empty" << endl;
+    exit(1);
+  }
+  cout << "c trace: " << snapshot_cnt << " snapshots, " << var_cnt
+       << " variables, " << clause_cnt << " clauses" << endl;
+
+  vector<Propagator> props = {
+      {"copy", nullptr, [](const int *, signed char *, int *, int, int) {}},
+      {"kernal", nullptr,
+       [](const int *c, signed char *out, int *reasons, int v, int n) {
+         kernal((int *)c, out, reasons, v, n);
+       }},
+      {"kernal_tiled", nullptr, kernal_tiled},
+      {"naive_scan", nullptr, naiveScan}};
+  for (const char *level : {"scalar", "avx2", "avx512"})
+    if (setSimdLevel(level))
+      props.push_back({string("kernal_simd/") + level, level, kernal_simd});
+
+  vector<signed char> buf(stride), reference, results;
+  vector<int> reasons(2 * var_cnt + 2);
+  double copy_time = 0;
+  long long implications = 0;
+  printf("%-20s %14s %10s %16s %7s  %s\n", "Benchmark", "ns/snapshot",
+         "ns/clause", "implications/s", "passes", "result");
+  for (const Propagator &p : props) {
+    bool is_ref = p.name == "kernal", is_copy = p.name == "copy";
+    // The reference and the copy baseline are needed by the others
+    if (!is_ref && !is_copy && !filter.empty() &&
+        p.name.find(filter) == string::npos)
+      continue;
+    if (p.simd) setSimdLevel(p.simd);
+
+    // One pass to check results, then timed ones
+    vector<signed char> &out = is_ref ? reference : results;
+    out.assign(snapshots.size(), 0);
+    for (size_t i = 0; i < snapshot_cnt; i++) {
+      memcpy(out.data() + i * stride, snapshots.data() + i * stride, stride);
+      p.run(clauses.data(), out.data() + i * stride, reasons.data(), var_cnt,
+            clause_cnt);
+    }
+    if (out[0] == -1) {
+      printf("%-20s %14s %10s %16s %7s  %s\n", p.name.c_str(), "-", "-", "-",
+             "-", "unsupported");
+      continue;
+    }
+    vector<double> times;
+    double total = 0;
+    while (total < min_time || times.size() < 3) {
+      auto start = chrono::steady_clock::now();
+      for (size_t i = 0; i < snapshot_cnt; i++) {
+        memcpy(buf.data(), snapshots.data() + i * stride, stride);
+        p.run(clauses.data(), buf.data(), reasons.data(), var_cnt,
+              clause_cnt);
+      }
+      times.push_back(
+          chrono::duration<double>(chrono::steady_clock::now() - start)
+              .count());
+      total += times.back();
+    }
+    sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+
+    if (is_copy) {
+      copy_time = median;
+      printf("%-20s %14.1f %10s %16s %7zu  %s\n", p.name.c_str(),
+             median / snapshot_cnt * 1e9, "-", "-", times.size(), "-");
+      continue;
+    }
+    string result = "reference";
+    if (is_ref) {
+      for (size_t i = 0; i < snapshot_cnt; i++) {
+        const signed char *in = snapshots.data() + i * stride,
+                          *ref = reference.data() + i * stride;
+        if (ref[0]) continue;
+        for (int v = 1; v <= var_cnt; v++) implications += in[v] != ref[v];
+      }
+    } else {
+      size_t differ = 0;
+      for (size_t i = 0; i < snapshot_cnt; i++) {
+        const signed char *ref = reference.data() + i * stride,
+                          *got = results.data() + i * stride;
+        differ += ref[0] != got[0] ||
+                  (!ref[0] && memcmp(ref + 1, got + 1, var_cnt) != 0);
+      }
+      result = differ == 0 ? "ok"
+                           : to_string(differ) + " of " +
+                                 to_string(snapshot_cnt) + " differ";
+    }
+    double t = max(median - copy_time, 1e-12);
+    printf("%-20s %14.1f %10.3f %16.4g %7zu  %s\n", p.name.c_str(),
+           t / snapshot_cnt * 1e9,
+           t / snapshot_cnt / clause_cnt * 1e9, implications / t,
+           times.size(), result.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+void HybridScheduler::Fit::add(double x, double y) {
+  n = n * HYBRID_DECAY + 1;
+  sx = sx * HYBRID_DECAY + x;
+  sy = sy * HYBRID_DECAY + y;
+  sxx = sxx * HYBRID_DECAY + x * x;
+  sxy = sxy * HYBRID_DECAY + x * y;
+}
+
+double HybridScheduler::Fit::slope() const {
+  double den = n * sxx - sx * sx;
+  // Every sample at (almost) the same x says nothing about the slope
+  if (n == 0 || den <= 1e-9 * n * sxx) return 0;
+  return max(0.0, (n * sxy - sx * sy) / den);
+}
+
+double HybridScheduler::Fit::at(double x) const {
+  if (n == 0) return 0;
+  double b = slope();
+  return max(0.0, (sy - b * sx) / n + b * x);
+}
+
+HybridScheduler::HybridScheduler(int var_cnt, int clause_cnt)
+    : clause_cnt(clause_cnt),
+      depth_active(var_cnt + 2, -1),
+      routed(var_cnt + 2, {0, 0}) {}
+
+// The estimate for depth, or the nearest shallower one that has one as
+// clauses only get satisfied going down
+double HybridScheduler::activeAt(int depth) const {
+  for (int d = depth; d >= 0; d--)
+    if (depth_active[d] >= 0) return depth_active[d];
+  return clause_cnt;
+}
+
+Backend HybridScheduler::route(int depth) {
+  depth = min(depth, (int)depth_active.size() - 1);
+  exploring = false;
+  if (cpu.n < HYBRID_WARMUP) return Cpu;
+  if (device.n < HYBRID_WARMUP) return Device;
+  Backend predicted =
+      cpu.at(activeAt(depth)) <= device.at(0) ? Cpu : Device;
+  if (explore_ns * HYBRID_EXPLORE < total_ns) {
+    exploring = true;
+    return predicted == Cpu ? Device : Cpu;
+  }
+  return predicted;
+}
+
+void HybridScheduler::record(Backend b, int depth, double ns, int active) {
+  depth = min(depth, (int)depth_active.size() - 1);
+  total_ns += ns;
+  if (exploring) {
+    explore_ns += ns;
+    explore_cnt[b]++;
+  } else
+    routed[depth][b]++;
+  if (b == Device) {
+    device.add(0, ns);
+    return;
+  }
+  cpu.add(active, ns);
+  double &est = depth_active[depth];
+  est = est < 0 ? active : est * 0.9 + active * 0.1;
+}
+
+void HybridScheduler::printStats(ostream &out) const {
+  long long calls[2] = {explore_cnt[Cpu], explore_cnt[Device]};
+  for (auto &r : routed) {
+    calls[Cpu] += r[Cpu];
+    calls[Device] += r[Device];
+  }
+  out << "c hybrid: " << calls[Cpu] + calls[Device] << " calls, "
+      << calls[Cpu] << " cpu, " << calls[Device] << " device, of which "
+      << explore_cnt[Cpu] + explore_cnt[Device] << " exploring" << endl;
+  double base = cpu.at(0), per_clause = cpu.slope(), trip = device.at(0);
+  out << "c hybrid: device " << trip / 1000 << " us, cpu " << base / 1000
+      << " us + " << per_clause << " ns per active clause, ";
+  if (base >= trip)
+    out << "device faster at any size" << endl;
+  else if (per_clause > 0)
+    out << "device faster past " << (long long)((trip - base) / per_clause)
+        << " active clauses" << endl;
+  else
+    out << "cpu faster at any size" << endl;
+  // Runs of depths that were mostly routed the same way, warmup included and
+  // exploring left out
+  for (int d = 0; d < (int)routed.size();) {
+    if (routed[d][Cpu] + routed[d][Device] == 0) {
+      d++;
+      continue;
+    }
+    bool to_cpu = routed[d][Cpu] >= routed[d][Device];
+    long long run[2] = {0, 0};
+    int end = d;
+    for (; end < (int)routed.size(); end++) {
+      long long c = routed[end][Cpu], g = routed[end][Device];
+      if (c + g > 0 && (c >= g) != to_cpu) break;
+      run[Cpu] += c;
+      run[Device] += g;
+    }
+    int last = end - 1;
+    while (routed[last][Cpu] + routed[last][Device] == 0) last--;
+    out << "c hybrid: depth " << d << "-" << last << " mostly "
+        << (to_cpu ? "cpu" : "device") << ", " << run[Cpu] << " cpu, "
+        << run[Device] << " device" << endl;
+    d = end;
+  }
+}
+
+int propagateActive(
+    const function<void(const int *, int, signed char *, int *)> &kernel,
+    const int *clauses, int clause_cnt, signed char *vars, int *reasons,
+    vector<int> &lits, vector<int> &index) {
+  lits.clear();
+  index.clear();
+  for (int c = 0; c < clause_cnt; c++) {
+    const int *cl = clauses + 3 * c;
+    bool sat = false;
+    for (int j = 0; j < 3; j++) sat |= vars[abs(cl[j])] == (cl[j] > 0);
+    if (sat) continue;
+    index.push_back(c);
+    lits.insert(lits.end(), cl, cl + 3);
+  }
+  int active = index.size();
+  if (active == 0) {
+    // Satisfied outright, nothing left to imply
+    vars[0] = 0;
+    reasons[0] = -1;
+    reasons[1] = 0;
+    return 0;
+  }
+  // A clause satisfied at the start stays so through the call, it can't
+  // imply anything or be falsified
+  kernel(lits.data(), active, vars, reasons);
+  // kernal_tiled's too many variables, left for the caller to report
+  if (vars[0] == -1) return active;
+  if (reasons[0] >= 0) reasons[0] = index[reasons[0]];
+  for (int i = 0; i < reasons[1]; i++)
+    reasons[3 + 2 * i] = index[reasons[3 + 2 * i]];
+  return active;
+}
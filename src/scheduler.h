@@ -0,0 +1,72 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <array>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+// Calls each backend gets before anything is routed by prediction
+#define HYBRID_WARMUP 4
+// At most 1 / HYBRID_EXPLORE of the time goes to calls routed against the
+// prediction, which keep the cost of the backend not being used measured
+#define HYBRID_EXPLORE 32
+// Weight a sample keeps per newer one, so the costs follow the search as it
+// moves instead of averaging over all of it
+#define HYBRID_DECAY 0.995
+
+enum Backend {
+  Cpu,
+  Device,
+};
+
+// Routes every propagation call to the backend predicted to be faster.
+// The device is a fixed round trip (launch, transfer, a pass over all the
+// clauses), measured as it goes. The CPU only propagates the active
+// clauses, ones not satisfied yet, so its cost is fitted as a + b * active.
+// Counting active clauses takes a pass of its own, so the count is
+// predicted from the decision depth instead: every CPU call updates the
+// estimate for its depth. The result is a threshold on the active count,
+// where the two costs cross, and with it one on the depth, past which the
+// CPU takes over.
+class HybridScheduler {
+ public:
+  HybridScheduler(int var_cnt, int clause_cnt);
+  Backend route(int depth);
+  // How long the call route() was last asked about took, and for a CPU call
+  // how many clauses were active
+  void record(Backend b, int depth, double ns, int active);
+  void printStats(std::ostream &out) const;
+
+ private:
+  // Least squares fit of y = a + b * x over exponentially decaying samples
+  struct Fit {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    void add(double x, double y);
+    double at(double x) const;
+    double slope() const;
+  };
+
+  int clause_cnt;
+  Fit cpu, device;
+  // Active clauses per depth, -1 until a CPU call has been made there
+  std::vector<double> depth_active;
+  // Calls per depth and backend, and ones routed against the prediction
+  std::vector<std::array<long long, 2>> routed;
+  long long explore_cnt[2] = {0, 0};
+  double total_ns = 0, explore_ns = 0;
+  bool exploring = false;
+
+  double activeAt(int depth) const;
+};
+
+// Propagates with kernel(clauses, clause_cnt, out, reasons), which has the
+// kernels' contract, on just the clauses not satisfied by vars, copied to
+// lits in order with their indices in index. The reasons are mapped back to
+// indices into clauses. Returns the number of those clauses.
+int propagateActive(
+    const std::function<void(const int *, int, signed char *, int *)> &kernel,
+    const int *clauses, int clause_cnt, signed char *vars, int *reasons,
+    std::vector<int> &lits, std::vector<int> &index);
+
+#endif
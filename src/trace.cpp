@@ -0,0 +1,112 @@
+#include "trace.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "cnf.h"
+
+using namespace std;
+
+static const char MAGIC[8] = {'F', 'S', 'A', 'T', 'T', 'R', 'C', '1'};
+
+static void putVarint(vector<unsigned char> &buf, unsigned long long x) {
+  for (; x >= 0x80; x >>= 7) buf.push_back(x | 0x80);
+  buf.push_back(x);
+}
+
+TraceWriter::TraceWriter(string path, const vector<int> &clauses,
+                         int var_cnt, bool reordered)
+    : var_cnt(var_cnt) {
+  out = fopen(path.c_str(), "wb");
+  if (!out) {
+    cerr << "Error: couldn't open trace file " << path << endl;
+    exit(1);
+  }
+  TraceHeader h = {};
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.var_cnt = var_cnt;
+  h.clause_cnt = clauses.size() / 3;
+  h.clause_hash = hashBytes(clauses.data(), clauses.size() * sizeof(int));
+  h.reordered = reordered;
+  fwrite(&h, sizeof(h), 1, out);
+}
+
+TraceWriter::~TraceWriter() { fclose(out); }
+
+void TraceWriter::add(const signed char *vars) {
+  if (snapshot_cnt == TRACE_LIMIT) return;
+  snapshot_cnt++;
+  buf.clear();
+  int assigned = 0;
+  for (int v = 1; v <= var_cnt; v++) assigned += vars[v] != -1;
+  putVarint(buf, assigned);
+  for (int v = 1, prev = 0; v <= var_cnt; v++) {
+    if (vars[v] == -1) continue;
+    putVarint(buf, (unsigned long long)(v - prev) << 1 | vars[v]);
+    prev = v;
+  }
+  fwrite(buf.data(), 1, buf.size(), out);
+}
+
+void readTrace(string path, const vector<int> &clauses, int var_cnt,
+               bool reordered, vector<signed char> &snapshots) {
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) {
+    cerr << "Error: couldn't open file " << path << endl;
+    exit(0);
+  }
+  TraceHeader h;
+  bool ok = fread(&h, sizeof(h), 1, in) == 1 &&
+            !memcmp(h.magic, MAGIC, sizeof(MAGIC));
+  if (!ok) {
+    cerr << "Error: " << path << " is not a trace" << endl;
+    exit(1);
+  }
+  if (h.var_cnt != var_cnt || h.clause_cnt != (int64_t)clauses.size() / 3 ||
+      h.reordered != reordered ||
+      h.clause_hash !=
+          hashBytes(clauses.data(), clauses.size() * sizeof(int))) {
+    cerr << "Error: " << path << " was recorded on other clauses"
+         << (h.reordered != reordered ? " (check --reorder)" : "") << endl;
+    exit(1);
+  }
+
+  vector<unsigned char> data;
+  unsigned char chunk[1 << 16];
+  for (size_t n; (n = fread(chunk, 1, sizeof(chunk), in)) > 0;)
+    data.insert(data.end(), chunk, chunk + n);
+  fclose(in);
+
+  size_t pos = 0;
+  bool truncated = false;
+  auto getVarint = [&]() {
+    unsigned long long x = 0;
+    for (int shift = 0;; shift += 7) {
+      if (pos == data.size() || shift > 63) {
+        truncated = true;
+        return 0ULL;
+      }
+      unsigned char b = data[pos++];
+      x |= (unsigned long long)(b & 0x7f) << shift;
+      if (!(b & 0x80)) return x;
+    }
+  };
+  snapshots.clear();
+  while (pos < data.size() && !truncated) {
+    size_t base = snapshots.size();
+    snapshots.resize(base + var_cnt + 1, -1);
+    snapshots[base] = 0;
+    unsigned long long assigned = getVarint();
+    long long v = 0;
+    for (unsigned long long i = 0; i < assigned && !truncated; i++) {
+      unsigned long long x = getVarint();
+      v += x >> 1;
+      if (v < 1 || v > var_cnt) truncated = true;
+      if (!truncated) snapshots[base + v] = x & 1;
+    }
+  }
+  if (truncated) {
+    cerr << "Error: " << path << " is truncated or corrupt" << endl;
+    exit(1);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Snapshots past this many are not recorded
+#define TRACE_LIMIT 100000
+
+// Binary trace of the partial assignments a search handed to propagation,
+// so that propbench can replay exactly the same ones through every
+// propagator. A TraceHeader, then per snapshot the number of assigned
+// variables followed by each as varint((var - previous var) << 1 | value),
+// in variable order. The trace ends with the file.
+struct TraceHeader {
+  char magic[8];
+  int64_t var_cnt, clause_cnt;
+  // hashBytes() over the clause buffer the snapshots were propagated on,
+  // and whether it was renumbered by reorderCNF() first
+  uint64_t clause_hash;
+  int64_t reordered;
+};
+
+class TraceWriter {
+ public:
+  // Exits if path can't be written
+  TraceWriter(std::string path, const std::vector<int> &clauses, int var_cnt,
+              bool reordered);
+  ~TraceWriter();
+  // vars[1..var_cnt] as -1/0/1, ignored past TRACE_LIMIT snapshots
+  void add(const signed char *vars);
+  long long size() const { return snapshot_cnt; }
+
+ private:
+  FILE *out;
+  int var_cnt;
+  long long snapshot_cnt = 0;
+  std::vector<unsigned char> buf;
+};
+
+// Reads a trace into snapshots, snapshot i being
+// snapshots[i * (var_cnt + 1)..] with -1/0/1 per variable as in the kernels.
+// Exits on a malformed trace or one recorded on other clauses.
+void readTrace(std::string path, const std::vector<int> &clauses,
+               int var_cnt, bool reordered,
+               std::vector<signed char> &snapshots);
+
+#endif